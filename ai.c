@@ -0,0 +1,261 @@
+#include "ai.h"
+#include <stdio.h>
+#include <string.h>
+
+#define AI_BOX_X 10 /* collision box inside the 40x50 frame, as the man's */
+#define AI_BOX_W 20
+#define AI_BOX_H 50
+#define AI_EYE 20 /* pixels down from the top of the frame */
+#define AI_WAKE 480 /* pixels from the player, well inside resident chunks */
+#define AI_SIGHT 320
+#define AI_RANGE 200
+#define AI_RELOAD 40 /* ticks */
+#define AI_DYING 24
+#define AI_JUMP 8 /* pixels a tick up, as the man */
+#define AI_BULLET_LIFE 200
+#define AI_BUDGET_US 500 /* reported against, a twentieth of a tick */
+
+static unsigned long statTicks, statThinks, statPutOff, statOver;
+static double statUs, statWorstUs, statThinkUs;
+
+static int clearSight(const Tilemap *map, Real x, Real y, Real targetX);
+static void think(Horde *horde, int i, const Tilemap *map,
+                  const FlowField *flow, Real playerX, Real playerY);
+
+void aiInit(Horde *horde) { memset(horde, 0, sizeof(*horde)); }
+
+int aiSpawn(Horde *horde, Real x, Real width) {
+  int i = horde->count;
+
+  if (i == AI_MAX)
+    return -1;
+  horde->count++;
+  horde->x[i] = x;
+  horde->y[i] = 0;
+  horde->dy[i] = 0;
+  horde->left[i] = x;
+  horde->right[i] = x + width;
+  horde->timer[i] = (Sint16)(i % AI_RELOAD); /* they don't all fire at once */
+  horde->state[i] = AI_PATROL;
+  horde->facingLeft[i] = (Uint8)(i & 1);
+  horde->awake[i] = 0;
+  horde->life[i] = AI_LIFE;
+  return i;
+}
+
+/* no solid tile on the agent's eye row between it and the target */
+static int clearSight(const Tilemap *map, Real x, Real y, Real targetX) {
+  int ty = (realToInt(y) + AI_EYE) / TILE_SIZE;
+  int from = (realToInt(x) + AI_BOX_X) / TILE_SIZE;
+  int to = (realToInt(targetX) + AI_BOX_X) / TILE_SIZE;
+  int tx;
+
+  for (tx = SDL_min(from, to); tx <= SDL_max(from, to); tx++)
+    if (tilemapTile(map, tx, ty) != TILE_EMPTY)
+      return 0;
+  return 1;
+}
+
+static void think(Horde *horde, int i, const Tilemap *map,
+                  const FlowField *flow, Real playerX, Real playerY) {
+  Real dx = playerX - horde->x[i];
+  Real dy = playerY - horde->y[i];
+  Real reach = dx < 0 ? -dx : dx;
+  int seen;
+
+  if (horde->state[i] == AI_DEAD)
+    return;
+  if (!horde->awake[i]) {
+    horde->state[i] = AI_PATROL;
+    return;
+  }
+  seen = reach <= realFromInt(AI_SIGHT) &&
+         clearSight(map, horde->x[i], horde->y[i], playerX);
+  if (seen)
+    horde->facingLeft[i] = dx < 0;
+
+  /* level shots only, so not at a player on a ledge above or below */
+  if (seen && reach < realFromInt(AI_RANGE) && dy > -realFromInt(AI_BOX_H) &&
+      dy < realFromInt(AI_BOX_H))
+    horde->state[i] = AI_SHOOT;
+  else if (flowDistance(flow, realToInt(horde->x[i]) + 20,
+                        realToInt(horde->y[i]) + AI_BOX_H - 1) != FLOW_FAR)
+    horde->state[i] = AI_CHASE;
+  else
+    horde->state[i] = seen ? AI_FACE : AI_PATROL;
+}
+
+void aiUpdate(Horde *horde, const Tilemap *map, const FlowField *flow,
+              Real playerX, Real playerY, BulletPool *gun) {
+  Uint64 start = SDL_GetPerformanceCounter();
+  Uint64 woke, thought;
+  Real wake = realFromInt(AI_WAKE);
+  Real speed = REAL_ONE;
+  Real chase = realFromInt(2);
+  int n = horde->count;
+  int wanted = (n + AI_THINK_TICKS - 1) / AI_THINK_TICKS;
+  int quota = SDL_min(wanted, AI_THINK_BUDGET);
+  double us;
+  int i;
+
+  /* awake near the player only, where the tiles are resident */
+  for (i = 0; i < n; i++) {
+    Real d = horde->x[i] - playerX;
+    horde->awake[i] =
+        (Uint8)((d > -wake) & (d < wake) & (horde->state[i] != AI_DEAD));
+  }
+
+  woke = SDL_GetPerformanceCounter();
+
+  /* the next agents in turn decide, never more than the budget */
+  for (i = 0; i < quota; i++) {
+    think(horde, horde->cursor, map, flow, playerX, playerY);
+    horde->cursor = (horde->cursor + 1) % n;
+  }
+  statPutOff += (unsigned long)(wanted - quota);
+  statThinks += (unsigned long)quota;
+  thought = SDL_GetPerformanceCounter();
+
+  for (i = 0; i < n; i++) {
+    TileBox box;
+    Real dx = 0;
+    int hits, go;
+
+    if (!horde->awake[i])
+      continue;
+    if (horde->state[i] == AI_PATROL)
+      dx = horde->facingLeft[i] ? -speed : speed;
+    if (horde->state[i] == AI_CHASE) {
+      /* the way changes as the player moves, decided or not */
+      go = flowSample(flow, realToInt(horde->x[i]) + 20,
+                      realToInt(horde->y[i]) + AI_BOX_H - 1);
+      dx = go & FLOW_GO_LEFT ? -chase : go & FLOW_GO_RIGHT ? chase : 0;
+      if (dx != 0)
+        horde->facingLeft[i] = dx < 0;
+      if ((go & FLOW_GO_UP) && horde->dy[i] == 0)
+        horde->dy[i] = realFromInt(-AI_JUMP);
+    }
+    horde->dy[i] += REAL(0.5);
+    box.x = horde->x[i] + realFromInt(AI_BOX_X);
+    box.y = horde->y[i];
+    box.w = realFromInt(AI_BOX_W);
+    box.h = realFromInt(AI_BOX_H);
+    hits = tilemapMove(map, &box, dx, horde->dy[i]);
+    horde->x[i] = box.x - realFromInt(AI_BOX_X);
+    horde->y[i] = box.y;
+    if (hits & (TILE_HIT_FLOOR | TILE_HIT_CEILING))
+      horde->dy[i] = 0;
+
+    /* patrols turn at walls and at their ends */
+    if (horde->state[i] != AI_PATROL)
+      continue;
+    if (hits & TILE_HIT_WALL)
+      horde->facingLeft[i] ^= 1;
+    if (horde->x[i] <= horde->left[i])
+      horde->facingLeft[i] = 0;
+    if (horde->x[i] >= horde->right[i])
+      horde->facingLeft[i] = 1;
+  }
+
+  for (i = 0; i < n; i++)
+    horde->timer[i] = (Sint16)(horde->timer[i] - (horde->timer[i] > 0));
+  for (i = 0; i < n; i++) {
+    int left = horde->facingLeft[i];
+
+    if (!horde->awake[i] || horde->state[i] != AI_SHOOT || horde->timer[i])
+      continue;
+    bulletAdd(gun, horde->x[i] + realFromInt(left ? 5 : 35),
+              horde->y[i] + realFromInt(AI_EYE), realFromInt(left ? -2 : 2),
+              0, AI_BULLET_LIFE);
+    horde->timer[i] = AI_RELOAD;
+  }
+
+  us = (double)(SDL_GetPerformanceCounter() - start) * 1e6 /
+       (double)SDL_GetPerformanceFrequency();
+  statThinkUs += (double)(thought - woke) * 1e6 /
+                 (double)SDL_GetPerformanceFrequency();
+  statUs += us;
+  if (us > statWorstUs)
+    statWorstUs = us;
+  if (us > AI_BUDGET_US)
+    statOver++;
+  statTicks++;
+}
+
+/*
+ * The grid holds where the bullets landed. Each agent's query box is grown
+ * by the farthest any of them moved, so it finds every bullet that could
+ * have crossed the agent on the way, and the bullet's swept segment
+ * decides, as bulletsMove() does for the man.
+ */
+int aiHits(Horde *horde, const Grid *grid, BulletPool *pool,
+           int killed[AI_MAX]) {
+  static Uint16 found[BULLET_POOL_MAX];
+  Real reachX = 0, reachY = 0;
+  int growX, growY;
+  int kills = 0;
+  int i, k, n;
+
+  if (pool->count == 0)
+    return 0;
+  for (i = 0; i < pool->count; i++) {
+    const Bullet *b = &pool->items[i];
+    reachX = SDL_max(reachX, SDL_max(b->dx, -b->dx));
+    reachY = SDL_max(reachY, SDL_max(b->dy, -b->dy));
+  }
+  growX = realToInt(reachX) + 1;
+  growY = realToInt(reachY) + 1;
+
+  for (i = 0; i < horde->count; i++) {
+    int left = realToInt(horde->x[i]) + AI_BOX_X;
+    int top = realToInt(horde->y[i]);
+    Real boxLeft = horde->x[i] + realFromInt(AI_BOX_X);
+
+    if (horde->state[i] == AI_DEAD)
+      continue;
+    n = gridQuery(grid, left - growX, top - growY, left + AI_BOX_W + growX,
+                  top + AI_BOX_H + growY, found);
+    for (k = 0; k < n && horde->state[i] != AI_DEAD; k++) {
+      Bullet *b = &pool->items[grid->items[found[k]].index];
+
+      if (b->life <= 0)
+        continue; /* spent on another agent already */
+      if (!bulletCrossed(b, boxLeft, horde->y[i],
+                         boxLeft + realFromInt(AI_BOX_W),
+                         horde->y[i] + realFromInt(AI_BOX_H)))
+        continue;
+      b->life = 0;
+      if (--horde->life[i] > 0)
+        continue;
+      horde->state[i] = AI_DEAD;
+      horde->awake[i] = 0;
+      horde->timer[i] = AI_DYING;
+      killed[kills++] = i;
+    }
+  }
+  return kills;
+}
+
+int aiSprite(const Horde *horde, int i, int tick) {
+  switch (horde->state[i]) {
+  case AI_DEAD:
+    return horde->timer[i] > AI_DYING / 2 ? 6 : horde->timer[i] > 0 ? 7 : -1;
+  case AI_PATROL:
+  case AI_CHASE:
+    return horde->awake[i] ? (tick / 6 + i) % 4 : 4;
+  case AI_SHOOT:
+    return horde->timer[i] > AI_RELOAD - 6 ? 5 : 4;
+  default:
+    return 4;
+  }
+}
+
+void aiPrintStats(void) {
+  if (statTicks == 0)
+    return;
+  printf("ai: %lu ticks, %.1f us each (%.1f worst, %lu over %d us), "
+         "%.2f us a think, %lu thinks put off\n",
+         statTicks, statUs / (double)statTicks, statWorstUs, statOver,
+         AI_BUDGET_US, statThinks ? statThinkUs / (double)statThinks : 0.0,
+         statPutOff);
+}
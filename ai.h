@@ -0,0 +1,77 @@
+#ifndef AI_H
+#define AI_H
+
+#include "bullets.h"
+#include "flow.h"
+#include "grid.h"
+#include "tilemap.h"
+
+/*
+ * Enemies by the hundred. Each field of every agent is its own array, and
+ * each tick runs a few passes over them: which are awake (near enough to
+ * the player for their chunks to be resident), their walking speed from
+ * their state, movement against the tiles for the awake ones, and firing.
+ *
+ * Deciding what to do is the expensive part, a sight line traced through
+ * the tiles, so it is time-sliced: agents think in turn, round robin, each
+ * about every AI_THINK_TICKS ticks and staggered by index. No tick thinks
+ * for more than AI_THINK_BUDGET agents; with more agents than that covers
+ * everyone thinks less often instead. The budget counts agents rather than
+ * microseconds so every machine simulates the same, see aiPrintStats() for
+ * what it costs.
+ *
+ * Agents that cannot shoot the player but have a route to him chase him
+ * down a FlowField built once for all of them, looked up every tick.
+ *
+ * A Horde is plain values, snapshots copy it as is.
+ */
+
+#define AI_MAX 512
+#define AI_THINK_TICKS 8
+#define AI_THINK_BUDGET 48
+#define AI_LIFE 3 /* hits an agent takes */
+
+#define AI_PATROL 0 /* walking between its patrol ends */
+#define AI_FACE 1   /* standing, turned to the player */
+#define AI_SHOOT 2  /* as AI_FACE, firing when reloaded */
+#define AI_CHASE 3  /* following the flow field */
+#define AI_DEAD 4
+
+typedef struct {
+  int count;
+  int cursor; /* the next agent to think */
+  Real x[AI_MAX], y[AI_MAX], dy[AI_MAX];
+  Real left[AI_MAX], right[AI_MAX]; /* patrol ends */
+  Sint16 timer[AI_MAX];             /* reloading, or dying */
+  Uint8 state[AI_MAX];
+  Uint8 facingLeft[AI_MAX];
+  Uint8 awake[AI_MAX];
+  Uint8 life[AI_MAX];
+} Horde;
+
+void aiInit(Horde *horde);
+
+/* an agent patrolling width pixels from x, it drops to the ground once awake */
+int aiSpawn(Horde *horde, Real x, Real width);
+
+/*
+ * One tick for every agent, given the player's box and a flow field toward
+ * him. Shots go into gun, aimed level along the agent's facing.
+ */
+void aiUpdate(Horde *horde, const Tilemap *map, const FlowField *flow,
+              Real playerX, Real playerY, BulletPool *gun);
+
+/*
+ * Damages the agents the grid's bullets crossed on their last move and
+ * spends those bullets in pool. The agents killed go to killed; returns
+ * how many.
+ */
+int aiHits(Horde *horde, const Grid *grid, BulletPool *pool,
+           int killed[AI_MAX]);
+
+/* walking, standing and dying frames of the enemy sheet, -1 once gone */
+int aiSprite(const Horde *horde, int i, int tick);
+
+void aiPrintStats(void);
+
+#endif
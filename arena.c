@@ -0,0 +1,63 @@
+#include "arena.h"
+#include <string.h>
+
+static Arena frameArenas[2];
+static int current;
+
+int arenaInit(Arena *arena, size_t size) {
+  memset(arena, 0, sizeof(*arena));
+  arena->base = (Uint8 *)malloc(size);
+  if (!arena->base)
+    return -1;
+  arena->size = size;
+  return 0;
+}
+
+void arenaFree(Arena *arena) {
+  free(arena->base);
+  memset(arena, 0, sizeof(*arena));
+}
+
+void *arenaAlloc(Arena *arena, size_t bytes) {
+  size_t start = (arena->used + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+  if (start > arena->size || bytes > arena->size - start)
+    return NULL;
+
+  arena->used = start + bytes;
+  if (arena->used > arena->highWater)
+    arena->highWater = arena->used;
+  return arena->base + start;
+}
+
+void arenaReset(Arena *arena) { arena->used = 0; }
+
+int frameArenaInit(size_t size) {
+  current = 0;
+  if (arenaInit(&frameArenas[0], size) != 0)
+    return -1;
+  if (arenaInit(&frameArenas[1], size) != 0) {
+    arenaFree(&frameArenas[0]);
+    return -1;
+  }
+  return 0;
+}
+
+void frameArenaShutdown(void) {
+  arenaFree(&frameArenas[0]);
+  arenaFree(&frameArenas[1]);
+}
+
+/* flips buffers; the one taking over held data from two frames ago */
+void frameArenaEndFrame(void) {
+  current ^= 1;
+  arenaReset(&frameArenas[current]);
+}
+
+void *frameAlloc(size_t bytes) {
+  return arenaAlloc(&frameArenas[current], bytes);
+}
+
+size_t frameArenaHighWater(void) {
+  return SDL_max(frameArenas[0].highWater, frameArenas[1].highWater);
+}
@@ -0,0 +1,38 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <SDL2/SDL.h>
+
+/*
+ * Linear (bump) allocator. Allocation is a pointer increment, nothing is
+ * freed individually, the whole arena is reset at once.
+ */
+
+#define ARENA_ALIGN 16
+
+typedef struct {
+  Uint8 *base;
+  size_t size;
+  size_t used;
+  size_t highWater;
+} Arena;
+
+int arenaInit(Arena *arena, size_t size);
+void arenaFree(Arena *arena);
+void *arenaAlloc(Arena *arena, size_t bytes); /* NULL when exhausted */
+void arenaReset(Arena *arena);
+
+/*
+ * Frame arenas: transient data lives for the frame that allocated it and
+ * the one after, two buffers taking turns, so whatever a frame hands on
+ * stays valid while the next one allocates. Anything else the frame loop
+ * needs must be preallocated; memtrack.h checks that it stays that way.
+ */
+
+int frameArenaInit(size_t size);
+void frameArenaShutdown(void);
+void frameArenaEndFrame(void);
+void *frameAlloc(size_t bytes);
+size_t frameArenaHighWater(void);
+
+#endif
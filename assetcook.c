@@ -0,0 +1,187 @@
+#include "assetpack.h"
+#include "audio.h"
+#include "tilemap.h"
+#include <SDL2/SDL_image.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Build tool: decodes the PNGs given on the command line and writes them as
+ * one cooked pack. Run by the Makefile, not shipped.
+ *
+ *   assetcook assets.pak sheet.png bullet.png ...
+ *
+ * or generates a level of the given width in tiles:
+ *
+ *   assetcook --level level1.lvl 4000 [seed]
+ *
+ * or cooks the sound effects, from WAVs in SOUND_* order or, without them,
+ * made up on the spot:
+ *
+ *   assetcook --sounds sounds.pak [shot.wav volley.wav hit.wav death.wav]
+ */
+
+#define MAX_ASSETS 64
+#define SHOT_FRAMES (AUDIO_RATE / 12)
+#define VOLLEY_FRAMES (AUDIO_RATE / 8)
+#define HIT_FRAMES (AUDIO_RATE / 25)
+#define DEATH_FRAMES (AUDIO_RATE / 2)
+
+static Sint16 shotSamples[SHOT_FRAMES];
+static Sint16 volleySamples[VOLLEY_FRAMES];
+static Sint16 hitSamples[HIT_FRAMES];
+static Sint16 deathSamples[DEATH_FRAMES];
+
+static Uint32 noise(Uint32 *seed);
+static void synthesize(SoundClip clips[SOUND_COUNT]);
+static int cookSounds(const char *path, int wavs, char *wavPaths[]);
+
+static Uint32 noise(Uint32 *seed) {
+  *seed = *seed * 1664525u + 1013904223u;
+  return *seed >> 16;
+}
+
+/* square, triangle and noise with falling envelopes */
+static void synthesize(SoundClip clips[SOUND_COUNT]) {
+  Uint32 seed = 12345;
+  float phase = 0, low = 0;
+  int i;
+
+  for (i = 0; i < SHOT_FRAMES; i++) {
+    float t = (float)i / SHOT_FRAMES;
+    float freq = 1400.0f - 1100.0f * t;
+    phase += freq / AUDIO_RATE;
+    if (phase >= 1)
+      phase -= 1;
+    shotSamples[i] =
+        (Sint16)((phase < 0.5f ? 9000.0f : -9000.0f) * (1 - t) * (1 - t));
+  }
+  phase = 0;
+  for (i = 0; i < VOLLEY_FRAMES; i++) {
+    float t = (float)i / VOLLEY_FRAMES;
+    float freq = 220.0f - 110.0f * t;
+    float tri;
+    phase += freq / AUDIO_RATE;
+    if (phase >= 1)
+      phase -= 1;
+    tri = phase < 0.5f ? 4 * phase - 1 : 3 - 4 * phase;
+    volleySamples[i] = (Sint16)(tri * 7000.0f * (1 - t));
+  }
+  for (i = 0; i < HIT_FRAMES; i++) {
+    float t = (float)i / HIT_FRAMES;
+    hitSamples[i] =
+        (Sint16)(((float)noise(&seed) - 32768.0f) * 0.25f * (1 - t) * (1 - t));
+  }
+  for (i = 0; i < DEATH_FRAMES; i++) {
+    float t = (float)i / DEATH_FRAMES;
+    /* one-pole low-pass, a rumble rather than a hiss */
+    low += (((float)noise(&seed) - 32768.0f) - low) * 0.05f;
+    deathSamples[i] = (Sint16)(low * 1.5f * (1 - t));
+  }
+
+  clips[SOUND_SHOT].samples = shotSamples;
+  clips[SOUND_SHOT].frames = SHOT_FRAMES;
+  clips[SOUND_VOLLEY].samples = volleySamples;
+  clips[SOUND_VOLLEY].frames = VOLLEY_FRAMES;
+  clips[SOUND_HIT].samples = hitSamples;
+  clips[SOUND_HIT].frames = HIT_FRAMES;
+  clips[SOUND_DEATH].samples = deathSamples;
+  clips[SOUND_DEATH].frames = DEATH_FRAMES;
+}
+
+static int cookSounds(const char *path, int wavs, char *wavPaths[]) {
+  static const char *const names[SOUND_COUNT] = SOUND_NAMES;
+  SoundClip clips[SOUND_COUNT];
+  Sint16 *decoded[SOUND_COUNT];
+  int rc = 0;
+  int i;
+
+  if (wavs != 0 && wavs != SOUND_COUNT) {
+    printf("usage: assetcook --sounds <out.pak> [<wav> x %d]\n",
+           SOUND_COUNT);
+    return 1;
+  }
+  synthesize(clips);
+  for (i = 0; i < wavs; i++) {
+    int frames;
+
+    if (soundLoadWav(wavPaths[i], &decoded[i], &frames) != 0) {
+      wavs = i;
+      rc = 1;
+      break;
+    }
+    clips[i].samples = decoded[i];
+    clips[i].frames = frames;
+  }
+  for (i = 0; i < SOUND_COUNT; i++)
+    clips[i].name = names[i];
+
+  if (rc == 0)
+    rc = soundPackWrite(path, clips, SOUND_COUNT) == 0 ? 0 : 1;
+  for (i = 0; i < wavs; i++)
+    free(decoded[i]);
+  return rc;
+}
+
+int main(int argc, char *argv[]) {
+  SDL_Surface *surfaces[MAX_ASSETS];
+  AssetImage images[MAX_ASSETS];
+  int count = argc - 2;
+  int rc = 0;
+  int i;
+
+  if (argc >= 4 && strcmp(argv[1], "--level") == 0) {
+    int width = atoi(argv[3]);
+    Uint32 seed = argc > 4 ? (Uint32)strtoul(argv[4], NULL, 10) : 1;
+
+    if (tilemapGenerate(argv[2], width, seed) != 0) {
+      printf("Cannot write %s\n", argv[2]);
+      return 1;
+    }
+    return 0;
+  }
+  if (argc >= 3 && strcmp(argv[1], "--sounds") == 0)
+    return cookSounds(argv[2], argc - 3, argv + 3);
+
+  if (count < 1 || count > MAX_ASSETS) {
+    printf("usage: %s <out.pak> <image>... (at most %d images)\n", argv[0],
+           MAX_ASSETS);
+    return 1;
+  }
+
+  for (i = 0; i < count; i++) {
+    const char *path = argv[i + 2];
+    const char *slash = strrchr(path, '/');
+    SDL_Surface *loaded = IMG_Load(path);
+
+    if (!loaded) {
+      printf("Cannot load %s\n", path);
+      puts(IMG_GetError());
+      count = i;
+      rc = 1;
+      break;
+    }
+    surfaces[i] = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_RGBA32, 0);
+    SDL_FreeSurface(loaded);
+    if (!surfaces[i]) {
+      count = i;
+      rc = 1;
+      break;
+    }
+
+    /* assets are looked up by the name the game asks for, not the path */
+    images[i].name = slash ? slash + 1 : path;
+    images[i].w = surfaces[i]->w;
+    images[i].h = surfaces[i]->h;
+    images[i].pitch = surfaces[i]->pitch;
+    images[i].pixels = surfaces[i]->pixels;
+  }
+
+  if (rc == 0)
+    rc = assetPackWrite(argv[1], images, count) == 0 ? 0 : 1;
+
+  for (i = 0; i < count; i++)
+    SDL_FreeSurface(surfaces[i]);
+  return rc;
+}
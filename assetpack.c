@@ -0,0 +1,186 @@
+#include "assetpack.h"
+#include <stdio.h>
+#include <string.h>
+
+#define HEADER_SIZE 12
+#define ENTRY_SIZE (ASSETPACK_NAME_LEN + 16)
+#define DATA_ALIGN 16
+#define FNV_PRIME 16777619u
+
+static Uint32 readLE32(const Uint8 *p);
+static size_t alignUp(size_t n);
+
+static Uint32 readLE32(const Uint8 *p) {
+  return (Uint32)p[0] | (Uint32)p[1] << 8 | (Uint32)p[2] << 16 |
+         (Uint32)p[3] << 24;
+}
+
+static size_t alignUp(size_t n) {
+  return (n + DATA_ALIGN - 1) & ~(size_t)(DATA_ALIGN - 1);
+}
+
+Uint32 assetHashBytes(Uint32 hash, const void *data, size_t n) {
+  const Uint8 *p = (const Uint8 *)data;
+  size_t i;
+  for (i = 0; i < n; i++) {
+    hash ^= p[i];
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+/* hashes the visible pixels only, so row padding never splits duplicates */
+Uint32 assetHashPixels(const void *pixels, int w, int h, int pitch) {
+  const Uint8 *row = (const Uint8 *)pixels;
+  Uint32 hash = ASSET_HASH_BASIS;
+  int y;
+
+  hash = assetHashBytes(hash, &w, sizeof(w));
+  hash = assetHashBytes(hash, &h, sizeof(h));
+  for (y = 0; y < h; y++) {
+    hash = assetHashBytes(hash, row, (size_t)w * 4);
+    row += pitch;
+  }
+  return hash;
+}
+
+int assetPackOpenMemory(AssetPack *pack, const void *data, size_t size) {
+  const Uint8 *p = (const Uint8 *)data;
+  Uint32 count;
+  Uint32 i;
+
+  memset(pack, 0, sizeof(*pack));
+  if (size < HEADER_SIZE || memcmp(p, "CPAK", 4) != 0 ||
+      readLE32(p + 4) != ASSETPACK_VERSION)
+    return -1;
+
+  count = readLE32(p + 8);
+  if ((size - HEADER_SIZE) / ENTRY_SIZE < count)
+    return -1;
+
+  /* validate once here so lookups can trust every entry */
+  for (i = 0; i < count; i++) {
+    const Uint8 *e = p + HEADER_SIZE + i * ENTRY_SIZE;
+    size_t w = readLE32(e + ASSETPACK_NAME_LEN);
+    size_t h = readLE32(e + ASSETPACK_NAME_LEN + 4);
+    size_t offset = readLE32(e + ASSETPACK_NAME_LEN + 12);
+
+    if (e[ASSETPACK_NAME_LEN - 1] != '\0' || offset > size ||
+        (w && h > (size - offset) / (w * 4)))
+      return -1;
+  }
+
+  pack->data = p;
+  pack->size = size;
+  pack->count = count;
+  return 0;
+}
+
+int assetPackOpenFile(AssetPack *pack, const char *path) {
+  SDL_RWops *rw = SDL_RWFromFile(path, "rb");
+  Sint64 size;
+  Uint8 *buf;
+
+  memset(pack, 0, sizeof(*pack));
+  if (!rw)
+    return -1;
+
+  size = SDL_RWsize(rw);
+  if (size <= 0) {
+    SDL_RWclose(rw);
+    return -1;
+  }
+
+  buf = (Uint8 *)malloc((size_t)size);
+  if (!buf || SDL_RWread(rw, buf, (size_t)size, 1) != 1) {
+    free(buf);
+    SDL_RWclose(rw);
+    return -1;
+  }
+  SDL_RWclose(rw);
+
+  if (assetPackOpenMemory(pack, buf, (size_t)size) != 0) {
+    free(buf);
+    return -1;
+  }
+  pack->owned = buf;
+  return 0;
+}
+
+void assetPackClose(AssetPack *pack) {
+  free(pack->owned);
+  memset(pack, 0, sizeof(*pack));
+}
+
+int assetPackFind(const AssetPack *pack, const char *name, AssetImage *image) {
+  Uint32 i;
+
+  for (i = 0; i < pack->count; i++) {
+    const Uint8 *e = pack->data + HEADER_SIZE + i * ENTRY_SIZE;
+    if (strcmp((const char *)e, name) == 0) {
+      image->name = (const char *)e;
+      image->w = (int)readLE32(e + ASSETPACK_NAME_LEN);
+      image->h = (int)readLE32(e + ASSETPACK_NAME_LEN + 4);
+      image->pitch = image->w * 4;
+      image->hash = readLE32(e + ASSETPACK_NAME_LEN + 8);
+      image->pixels = pack->data + readLE32(e + ASSETPACK_NAME_LEN + 12);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int assetPackWrite(const char *path, const AssetImage *images, int count) {
+  static const Uint8 zeros[DATA_ALIGN] = {0};
+  SDL_RWops *rw = SDL_RWFromFile(path, "wb");
+  size_t offset;
+  size_t written;
+  int ok = 1;
+  int i;
+  int y;
+
+  if (!rw)
+    return -1;
+
+  ok &= SDL_RWwrite(rw, "CPAK", 4, 1) == 1;
+  ok &= SDL_WriteLE32(rw, ASSETPACK_VERSION) == 1;
+  ok &= SDL_WriteLE32(rw, (Uint32)count) == 1;
+
+  offset = alignUp(HEADER_SIZE + (size_t)count * ENTRY_SIZE);
+  for (i = 0; i < count; i++) {
+    char name[ASSETPACK_NAME_LEN];
+
+    memset(name, 0, sizeof(name));
+    SDL_strlcpy(name, images[i].name, sizeof(name));
+    ok &= SDL_RWwrite(rw, name, sizeof(name), 1) == 1;
+    ok &= SDL_WriteLE32(rw, (Uint32)images[i].w) == 1;
+    ok &= SDL_WriteLE32(rw, (Uint32)images[i].h) == 1;
+    ok &= SDL_WriteLE32(rw, assetHashPixels(images[i].pixels, images[i].w,
+                                            images[i].h, images[i].pitch)) ==
+          1;
+    ok &= SDL_WriteLE32(rw, (Uint32)offset) == 1;
+    offset = alignUp(offset + (size_t)images[i].w * (size_t)images[i].h * 4);
+  }
+
+  written = HEADER_SIZE + (size_t)count * ENTRY_SIZE;
+  for (i = 0; i < count; i++) {
+    const Uint8 *row = (const Uint8 *)images[i].pixels;
+    size_t rowBytes = (size_t)images[i].w * 4;
+
+    ok &= SDL_RWwrite(rw, zeros, 1, alignUp(written) - written) ==
+          alignUp(written) - written;
+    written = alignUp(written);
+    for (y = 0; y < images[i].h; y++) {
+      ok &= SDL_RWwrite(rw, row, rowBytes, 1) == 1;
+      row += images[i].pitch;
+    }
+    written += rowBytes * (size_t)images[i].h;
+  }
+
+  SDL_RWclose(rw);
+  if (!ok) {
+    printf("Cannot write %s\n", path);
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,49 @@
+#ifndef ASSETPACK_H
+#define ASSETPACK_H
+
+#include <SDL2/SDL.h>
+
+/*
+ * Cooked asset pack: images pre-decoded to RGBA32 so loading one is a
+ * pointer lookup instead of a PNG decode. Layout, all little endian:
+ *
+ *   "CPAK" | version | count | count * entry | pixel data
+ *   entry: name[ASSETPACK_NAME_LEN] | w | h | content hash | data offset
+ *
+ * Pixel rows are tightly packed (pitch = w * 4) and each image starts on a
+ * 16 byte boundary. The same bytes work mapped from disk or linked into the
+ * executable (see EMBED_ASSETS in the Makefile).
+ */
+
+#define ASSETPACK_VERSION 1
+#define ASSETPACK_NAME_LEN 48
+#define ASSET_HASH_BASIS 2166136261u
+
+typedef struct {
+  const char *name;
+  int w, h, pitch;
+  Uint32 hash;
+  const void *pixels;
+} AssetImage;
+
+typedef struct {
+  const Uint8 *data;
+  size_t size;
+  Uint32 count;
+  Uint8 *owned; /* heap copy when read from disk, NULL when embedded */
+} AssetPack;
+
+int assetPackOpenMemory(AssetPack *pack, const void *data, size_t size);
+int assetPackOpenFile(AssetPack *pack, const char *path);
+void assetPackClose(AssetPack *pack);
+
+/* returns 1 and fills image if the pack has name, 0 otherwise */
+int assetPackFind(const AssetPack *pack, const char *name, AssetImage *image);
+
+int assetPackWrite(const char *path, const AssetImage *images, int count);
+
+/* FNV-1a, shared with the texture cache so cooked and loaded hashes match */
+Uint32 assetHashBytes(Uint32 hash, const void *data, size_t n);
+Uint32 assetHashPixels(const void *pixels, int w, int h, int pitch);
+
+#endif
@@ -0,0 +1,180 @@
+#include "assetwatch.h"
+#include "ring.h"
+#include <SDL2/SDL_image.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#define MAX_PENDING 16 /* power of two */
+#define POLL_MS 100
+
+typedef struct {
+  char path[TEXCACHE_PATH_LEN];
+  SDL_Surface *surface; /* RGBA32, owned by the queue until pumped */
+} PendingAsset;
+
+static SDL_Thread *watchThread;
+static SDL_atomic_t quitWatch;
+static PendingAsset pendingSlots[MAX_PENDING];
+static Ring pending; /* the watcher to the main thread */
+static int watchFd = -1;
+static char watchDir[TEXCACHE_PATH_LEN];
+
+static int isPng(const char *name);
+static void queueAsset(const char *name);
+static int watchMain(void *data);
+
+static int isPng(const char *name) {
+  size_t n = strlen(name);
+  return n > 4 && strcmp(name + n - 4, ".png") == 0;
+}
+
+/* decodes on the watcher thread, then hands the surface over */
+static void queueAsset(const char *name) {
+  PendingAsset asset;
+  SDL_Surface *loaded;
+
+  if (strcmp(watchDir, ".") == 0)
+    SDL_snprintf(asset.path, sizeof(asset.path), "%s", name);
+  else
+    SDL_snprintf(asset.path, sizeof(asset.path), "%s/%s", watchDir, name);
+
+  loaded = IMG_Load(asset.path);
+  if (!loaded)
+    return;
+  asset.surface = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_RGBA32, 0);
+  SDL_FreeSurface(loaded);
+  if (asset.surface && ringPush(&pending, &asset, 1) == 0)
+    SDL_FreeSurface(asset.surface); /* the main thread is far behind */
+}
+
+#ifdef __linux__
+static int watchMain(void *data) {
+  union {
+    struct inotify_event event;
+    char bytes[4096];
+  } buf;
+  struct pollfd pfd;
+
+  (void)data;
+  pfd.fd = watchFd;
+  pfd.events = POLLIN;
+
+  while (!SDL_AtomicGet(&quitWatch)) {
+    ssize_t len;
+    ssize_t off;
+
+    /* wake up regularly to notice assetWatchStop() */
+    if (poll(&pfd, 1, POLL_MS) <= 0)
+      continue;
+
+    len = read(watchFd, buf.bytes, sizeof(buf.bytes));
+    for (off = 0; off < len;) {
+      const struct inotify_event *ev =
+          (const struct inotify_event *)(const void *)(buf.bytes + off);
+      if (ev->len > 0 && isPng(ev->name))
+        queueAsset(ev->name);
+      off += (ssize_t)(sizeof(struct inotify_event) + ev->len);
+    }
+  }
+  return 0;
+}
+
+int assetWatchStart(const char *dir) {
+  watchFd = inotify_init();
+  if (watchFd < 0)
+    return -1;
+
+  /* whole-file rewrites and editor save-by-rename both land here */
+  if (inotify_add_watch(watchFd, dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+    close(watchFd);
+    watchFd = -1;
+    return -1;
+  }
+
+  SDL_strlcpy(watchDir, dir, sizeof(watchDir));
+  ringInit(&pending, pendingSlots, sizeof(PendingAsset), MAX_PENDING);
+  SDL_AtomicSet(&quitWatch, 0);
+  watchThread = SDL_CreateThread(watchMain, "assetwatch", NULL);
+  if (!watchThread) {
+    close(watchFd);
+    watchFd = -1;
+    return -1;
+  }
+  return 0;
+}
+#else
+static int watchMain(void *data) {
+  (void)data;
+  return 0;
+}
+
+int assetWatchStart(const char *dir) {
+  (void)dir;
+  (void)watchMain;
+  return -1;
+}
+#endif
+
+void assetWatchPump(TexCache *cache) {
+  PendingAsset ready[MAX_PENDING];
+  Uint64 start;
+  int count;
+  int i, j;
+
+  if (!watchThread)
+    return;
+
+  count = ringPop(&pending, ready, MAX_PENDING);
+  for (i = 0; i < count; i++) {
+    SDL_Surface *s = ready[i].surface;
+    int reloaded;
+
+    /* editors often write twice in a row, only the newest decode counts */
+    for (j = i + 1; j < count; j++)
+      if (strcmp(ready[j].path, ready[i].path) == 0)
+        break;
+    if (j < count) {
+      SDL_FreeSurface(s);
+      continue;
+    }
+
+    start = SDL_GetPerformanceCounter();
+    reloaded = texCacheReload(cache, ready[i].path, s->pixels, s->w, s->h,
+                              s->pitch);
+#ifndef NDEBUG
+    if (reloaded)
+      printf("reloaded %s in %.3f ms\n", ready[i].path,
+             (double)(SDL_GetPerformanceCounter() - start) * 1000.0 /
+                 (double)SDL_GetPerformanceFrequency());
+#else
+    (void)reloaded;
+    (void)start;
+#endif
+    SDL_FreeSurface(s);
+  }
+}
+
+void assetWatchStop(void) {
+  PendingAsset left;
+
+  if (!watchThread)
+    return;
+
+  SDL_AtomicSet(&quitWatch, 1);
+  SDL_WaitThread(watchThread, NULL);
+  watchThread = NULL;
+
+#ifdef __linux__
+  close(watchFd);
+#endif
+  watchFd = -1;
+
+  while (ringPop(&pending, &left, 1) == 1)
+    SDL_FreeSurface(left.surface);
+}
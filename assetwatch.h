@@ -0,0 +1,18 @@
+#ifndef ASSETWATCH_H
+#define ASSETWATCH_H
+
+#include "texcache.h"
+
+/*
+ * Asset hot-reload. A watcher thread waits on inotify for PNGs in dir to be
+ * rewritten, decodes them to RGBA32 on its own time and queues the result.
+ * assetWatchPump() runs on the main thread between frames and only uploads
+ * what is already decoded, so a reload never stalls a frame on disk or
+ * libpng. Without inotify the watcher is simply not started.
+ */
+
+int assetWatchStart(const char *dir);
+void assetWatchPump(TexCache *cache);
+void assetWatchStop(void);
+
+#endif
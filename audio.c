@@ -0,0 +1,249 @@
+#include "audio.h"
+#include "ring.h"
+#include <stdio.h>
+#include <string.h>
+
+#define BLOCK_FRAMES 1024 /* mixed at a time, callbacks may ask for more */
+#define MIX_LANES 8 /* a fixed count the compiler vectorizes even at -O2 */
+
+#if MIX_LANES > SOUNDPACK_TAIL
+#error "mixing reads past the silence after a sound"
+#endif
+
+typedef struct {
+  int sound;
+  int priority;
+  float left, right; /* gains */
+} AudioCommand;
+
+static int ready;
+static int muted;
+static SDL_AudioDeviceID device;
+
+/* in the pack, with silence after each for whole lanes read past the end */
+static const Sint16 *soundSamples[SOUND_COUNT];
+static int soundFrames[SOUND_COUNT];
+
+static RingMP commands;
+static AudioCommand commandSlots[AUDIO_QUEUE];
+static SDL_atomic_t commandsPublished[AUDIO_QUEUE];
+static SDL_atomic_t notQueued;
+
+/* the playing voices, 0 to voiceCount - 1; the callback's alone */
+static int voiceCount;
+static int voiceSound[AUDIO_VOICES];
+static int voicePos[AUDIO_VOICES];
+static int voicePriority[AUDIO_VOICES];
+static float voiceLeft[AUDIO_VOICES];
+static float voiceRight[AUDIO_VOICES];
+static float mixLeft[BLOCK_FRAMES];
+static float mixRight[BLOCK_FRAMES];
+
+static unsigned long statCallbacks, statOverHalf, statStarted, statStolen;
+static unsigned long statDropped;
+static double statUs, statWorstUs, statAudioUs;
+static int statVoices;
+
+static void startVoice(const AudioCommand *cmd);
+static void mixBlock(Sint16 *out, int frames);
+static void SDLCALL callback(void *userdata, Uint8 *stream, int len);
+
+void audioInit(void) {
+  ringMPInit(&commands, commandSlots, commandsPublished, sizeof(AudioCommand),
+             AUDIO_QUEUE);
+  SDL_AtomicSet(&notQueued, 0);
+  voiceCount = 0;
+  muted = 0;
+  statCallbacks = statOverHalf = statStarted = statStolen = statDropped = 0;
+  statUs = statWorstUs = statAudioUs = 0;
+  statVoices = 0;
+  ready = 1;
+}
+
+void audioUsePack(const SoundPack *pack) {
+  SoundClip clip;
+  int i;
+
+  for (i = 0; i < SOUND_COUNT; i++) {
+    soundSamples[i] = soundPackGet(pack, i, &clip) ? clip.samples : NULL;
+    soundFrames[i] = soundSamples[i] ? clip.frames : 0;
+  }
+}
+
+int audioOpen(void) {
+  SDL_AudioSpec want, have;
+
+  audioInit();
+  if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0) {
+    printf("Cannot start audio: %s\n", SDL_GetError());
+    ready = 0;
+    return -1;
+  }
+  SDL_zero(want);
+  want.freq = AUDIO_RATE;
+  want.format = AUDIO_S16SYS;
+  want.channels = 2;
+  want.samples = AUDIO_FRAMES;
+  want.callback = callback;
+  /* SDL converts if the device differs, the mixer stays as it is */
+  device = SDL_OpenAudioDevice(NULL, 0, &want, &have, 0);
+  if (device == 0) {
+    printf("Cannot open audio: %s\n", SDL_GetError());
+    SDL_QuitSubSystem(SDL_INIT_AUDIO);
+    ready = 0; /* nobody would take the commands */
+    return -1;
+  }
+  SDL_PauseAudioDevice(device, 0);
+  return 0;
+}
+
+void audioClose(void) {
+  if (device == 0)
+    return;
+  SDL_CloseAudioDevice(device);
+  SDL_QuitSubSystem(SDL_INIT_AUDIO);
+  device = 0;
+}
+
+int audioPlay(int sound, float volume, float pan, int priority) {
+  AudioCommand cmd;
+
+  if (!ready || muted || sound < 0 || sound >= SOUND_COUNT ||
+      soundFrames[sound] == 0)
+    return 0;
+  pan = SDL_max(-1.0f, SDL_min(pan, 1.0f));
+  cmd.sound = sound;
+  cmd.priority = priority;
+  /* equal power, the middle is not quieter than the sides */
+  cmd.left = volume * SDL_sqrtf((1 - pan) * 0.5f);
+  cmd.right = volume * SDL_sqrtf((1 + pan) * 0.5f);
+  if (ringMPPush(&commands, &cmd, 1) == 0) {
+    SDL_AtomicAdd(&notQueued, 1);
+    return 0;
+  }
+  return 1;
+}
+
+void audioMute(int on) { muted = on; }
+
+/* a free voice, or the least important one if it is not above the sound */
+static void startVoice(const AudioCommand *cmd) {
+  int v = voiceCount;
+  int i;
+
+  if (voiceCount == AUDIO_VOICES) {
+    v = 0;
+    for (i = 1; i < AUDIO_VOICES; i++)
+      if (voicePriority[i] < voicePriority[v] ||
+          (voicePriority[i] == voicePriority[v] && voicePos[i] > voicePos[v]))
+        v = i;
+    if (voicePriority[v] > cmd->priority) {
+      statDropped++;
+      return;
+    }
+    statStolen++;
+  } else {
+    voiceCount++;
+  }
+  voiceSound[v] = cmd->sound;
+  voicePos[v] = 0;
+  voicePriority[v] = cmd->priority;
+  voiceLeft[v] = cmd->left;
+  voiceRight[v] = cmd->right;
+  statStarted++;
+  if (voiceCount > statVoices)
+    statVoices = voiceCount;
+}
+
+static void mixBlock(Sint16 *out, int frames) {
+  int whole = frames / MIX_LANES * MIX_LANES;
+  int v, i, j;
+
+  memset(mixLeft, 0, sizeof(mixLeft));
+  memset(mixRight, 0, sizeof(mixRight));
+  for (v = 0; v < voiceCount;) {
+    const Sint16 *src = soundSamples[voiceSound[v]] + voicePos[v];
+    int n = SDL_min(frames, soundFrames[voiceSound[v]] - voicePos[v]);
+    float left = voiceLeft[v], right = voiceRight[v];
+
+    /* rounded up to whole lanes, the block and the sound have room */
+    for (i = 0; i < n; i += MIX_LANES)
+      for (j = 0; j < MIX_LANES; j++) {
+        float s = (float)src[i + j];
+        mixLeft[i + j] += s * left;
+        mixRight[i + j] += s * right;
+      }
+    voicePos[v] += n;
+    if (voicePos[v] < soundFrames[voiceSound[v]]) {
+      v++;
+      continue;
+    }
+    /* finished, the last voice moves into its place */
+    voiceCount--;
+    voiceSound[v] = voiceSound[voiceCount];
+    voicePos[v] = voicePos[voiceCount];
+    voicePriority[v] = voicePriority[voiceCount];
+    voiceLeft[v] = voiceLeft[voiceCount];
+    voiceRight[v] = voiceRight[voiceCount];
+  }
+  for (i = 0; i < whole; i += MIX_LANES)
+    for (j = i; j < i + MIX_LANES; j++) {
+      out[2 * j] = (Sint16)SDL_max(-32768.0f, SDL_min(mixLeft[j], 32767.0f));
+      out[2 * j + 1] =
+          (Sint16)SDL_max(-32768.0f, SDL_min(mixRight[j], 32767.0f));
+    }
+  for (i = whole; i < frames; i++) {
+    out[2 * i] = (Sint16)SDL_max(-32768.0f, SDL_min(mixLeft[i], 32767.0f));
+    out[2 * i + 1] =
+        (Sint16)SDL_max(-32768.0f, SDL_min(mixRight[i], 32767.0f));
+  }
+}
+
+void audioMix(Uint8 *stream, int len) {
+  AudioCommand taken[AUDIO_QUEUE];
+  Sint16 *out = (Sint16 *)(void *)stream;
+  int frames = len / (int)(2 * sizeof(Sint16));
+  Uint64 start = SDL_GetPerformanceCounter();
+  double us, audioUs;
+  int n, i;
+
+  n = ringMPPop(&commands, taken, AUDIO_QUEUE);
+  for (i = 0; i < n; i++)
+    startVoice(&taken[i]);
+  while (frames > 0) {
+    n = SDL_min(frames, BLOCK_FRAMES);
+    mixBlock(out, n);
+    out += 2 * n;
+    frames -= n;
+  }
+
+  us = (double)(SDL_GetPerformanceCounter() - start) * 1e6 /
+       (double)SDL_GetPerformanceFrequency();
+  audioUs = (double)(len / (int)(2 * sizeof(Sint16))) * 1e6 / AUDIO_RATE;
+  statCallbacks++;
+  statUs += us;
+  statAudioUs += audioUs;
+  if (us > statWorstUs)
+    statWorstUs = us;
+  if (us > audioUs / 2)
+    statOverHalf++;
+}
+
+static void SDLCALL callback(void *userdata, Uint8 *stream, int len) {
+  (void)userdata;
+  audioMix(stream, len);
+}
+
+/* call with the device closed, or the callback may be running */
+void audioPrintStats(void) {
+  if (statCallbacks == 0)
+    return;
+  printf("audio: %lu callbacks, %.1f us each (%.1f worst) for %.0f us of "
+         "sound, %lu over half of it\n",
+         statCallbacks, statUs / (double)statCallbacks, statWorstUs,
+         statAudioUs / (double)statCallbacks, statOverHalf);
+  printf("audio: %lu sounds started, %lu on stolen voices, %lu dropped, "
+         "%d not queued, %d voices at most\n",
+         statStarted, statStolen, statDropped, SDL_AtomicGet(&notQueued),
+         statVoices);
+}
@@ -0,0 +1,59 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include "soundpack.h"
+
+/*
+ * Sound effects, mixed in software in SDL's audio callback. Any thread asks
+ * for a sound with audioPlay(), which only queues a command on a lock-free
+ * ring; the callback takes the commands and mixes every playing voice.
+ * Voices are parallel arrays and each is mixed into float accumulators in
+ * straight runs of a fixed number of frames, which the compiler vectorizes
+ * even at -O2, then the accumulators are clamped to 16 bits once.
+ *
+ * With every voice busy a new sound takes over the voice of the lowest
+ * priority, the one furthest through if several tie, as long as that is
+ * no higher than its own; otherwise it is dropped. The callback times
+ * itself against the audio it produces, see audioPrintStats().
+ *
+ * Sounds are mono 16-bit, played straight out of a cooked SoundPack in
+ * stereo with a volume and a pan.
+ */
+
+#define AUDIO_RATE SOUNDPACK_RATE /* mixed as cooked, no resampling */
+#define AUDIO_FRAMES 512 /* a callback's worth, about 12 ms */
+#define AUDIO_VOICES 32
+#define AUDIO_QUEUE 256 /* commands in flight, power of two */
+
+#define SOUND_SHOT 0
+#define SOUND_VOLLEY 1 /* the enemy firing a pattern */
+#define SOUND_HIT 2
+#define SOUND_DEATH 3
+#define SOUND_COUNT 4
+#define SOUND_NAMES {"shot", "volley", "hit", "death"}
+
+/* voices and commands, without a device; for benchmarks */
+void audioInit(void);
+
+/* plays the pack's sounds by ID, missing ones are silent; keep it open */
+void audioUsePack(const SoundPack *pack);
+
+/* audioInit() and the device, -1 with nothing opened */
+int audioOpen(void);
+void audioClose(void);
+
+/*
+ * Queues a sound, volume 0 to 1, pan -1 (left) to 1 (right). Returns 0 if
+ * the queue is full or there is no audio, the sound is then not played.
+ */
+int audioPlay(int sound, float volume, float pan, int priority);
+
+/* while muted nothing is played, for ticks being simulated over again */
+void audioMute(int muted);
+
+/* what the callback does, fills len bytes of interleaved stereo */
+void audioMix(Uint8 *stream, int len);
+
+void audioPrintStats(void);
+
+#endif
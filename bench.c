@@ -0,0 +1,839 @@
+#include "bench.h"
+#include "ai.h"
+#include "audio.h"
+#include "control.h"
+#include "emitter.h"
+#include "flow.h"
+#include "input.h"
+#include "ring.h"
+#include "tilemap.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_LEVEL "bench.lvl"
+/* as far as fixed point reaches in a FIXED_POINT build, see tilemap.h */
+#define BENCH_LEVEL_TILES SDL_min(100000, TILEMAP_MAX_CHUNKS * CHUNK_W)
+#define BENCH_VIEW_W 320
+#define BENCH_SCROLL 3 /* pixels per frame, the player's walking speed */
+#define BENCH_BODIES 4096
+#define BENCH_TICKS 1000
+#define BENCH_EMITTERS 4
+#define RING_ITEMS (1 << 22) /* through each ring */
+#define RING_SIZE 1024
+#define RING_BATCH 32
+#define RING_PRODUCERS 3
+#define AUDIO_CALLBACKS 4000
+#define AUDIO_PLAYS 6 /* per callback, about 500 sounds a second */
+#define BENCH_SOUNDS "sounds.pak" /* cooked by make */
+#define BENCH_WAV "bench.wav"
+#define BENCH_PATROL 96
+#define BENCH_VOLLEY 8 /* player bullets fired into the horde a tick */
+#define FLOW_AGENTS 4096
+#define FLOW_SPREAD 600 /* pixels either side of the player, resident */
+#define FLOW_SEARCHES 64 /* agents timed searching for themselves */
+#define CONTROL_MEN 4096
+
+/* one thread's end of a ring under test */
+typedef struct {
+  Ring *ring;
+  RingMP *ringMP;
+  Uint32 id;    /* producers tag items with it in the top byte */
+  int batch;
+  int items;
+  int failures; /* out of order or missing, consumer side */
+} RingEnd;
+
+static double elapsedMs(Uint64 start, Uint64 end);
+static int produce(void *data);
+static int consume(void *data);
+static double runRing(Ring *ring, RingMP *ringMP, int producers, int batch,
+                      int *failures);
+static long residentKb(const void *mapped);
+static int writeWav(const char *path, const SoundClip *clip);
+static void dropIn(TileBox *agent, const TileBox *player, Uint32 *seed);
+static void steerBranches(int count, const Uint8 *buttons, Uint8 *state,
+                          Uint8 *sprite, Sint8 *dx, Uint8 *fired, int tick);
+
+static double elapsedMs(Uint64 start, Uint64 end) {
+  return (double)(end - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+/*
+ * Scrolls a camera across a 100k tile level, or as wide as fixed point
+ * reaches, end to end at walking speed, streaming chunks like the game does
+ * and reading every visible tile like the renderer does.
+ */
+int benchTilemap(void) {
+  Tilemap map;
+  Uint64 start, before, now;
+  double streamMs = 0, worstMs = 0;
+  unsigned long frames = 0;
+  unsigned long solid = 0;
+  Sint64 fileSize;
+  int x, tx, ty;
+
+  start = SDL_GetPerformanceCounter();
+  if (tilemapGenerate(BENCH_LEVEL, BENCH_LEVEL_TILES, 1) != 0) {
+    printf("Cannot write %s\n", BENCH_LEVEL);
+    return 1;
+  }
+  now = SDL_GetPerformanceCounter();
+  if (tilemapOpen(&map, BENCH_LEVEL) != 0) {
+    printf("Cannot open %s\n", BENCH_LEVEL);
+    remove(BENCH_LEVEL);
+    return 1;
+  }
+  fileSize = SDL_RWsize(map.file);
+
+  printf("level: %d x %d tiles, %ld bytes on disk (%.3f per tile), "
+         "generated in %.1f ms\n",
+         map.widthChunks * CHUNK_W, CHUNK_H, (long)fileSize,
+         (double)fileSize / (map.widthChunks * CHUNK_W * CHUNK_H),
+         elapsedMs(start, now));
+
+  for (x = 0; x <= tilemapWidthPx(&map) - BENCH_VIEW_W; x += BENCH_SCROLL) {
+    double ms;
+
+    before = SDL_GetPerformanceCounter();
+    tilemapStream(&map, (float)x, BENCH_VIEW_W);
+    now = SDL_GetPerformanceCounter();
+    ms = elapsedMs(before, now);
+    streamMs += ms;
+    if (ms > worstMs)
+      worstMs = ms;
+
+    for (tx = x / TILE_SIZE; tx <= (x + BENCH_VIEW_W) / TILE_SIZE; tx++)
+      for (ty = 0; ty < CHUNK_H; ty++)
+        solid += tilemapTile(&map, tx, ty) != TILE_EMPTY;
+    frames++;
+  }
+
+  printf("scrolled %lu frames: %lu chunk loads, %lu evictions, "
+         "%.1f solid tiles in view\n",
+         frames, map.loads, map.evictions, (double)solid / (double)frames);
+  printf("streaming: %.3f us per frame on average, %.3f ms worst\n",
+         streamMs * 1000.0 / (double)frames, worstMs);
+  printf("resident: %lu bytes (%d chunks), whole level unpacked: %ld bytes\n",
+         (unsigned long)sizeof(map), TILEMAP_RESIDENT,
+         (long)map.widthChunks * CHUNK_W * CHUNK_H);
+
+  tilemapClose(&map);
+  remove(BENCH_LEVEL);
+  return 0;
+}
+
+/*
+ * Thousands of player-sized boxes walking, jumping and falling over the
+ * resident part of a level, every one resolved against the tiles each tick.
+ */
+int benchCollision(void) {
+  static TileBox boxes[BENCH_BODIES];
+  static Real dx[BENCH_BODIES], dy[BENCH_BODIES];
+  Tilemap map;
+  Uint32 seed = 1;
+  Uint64 start, end;
+  unsigned long landings = 0, walls = 0;
+  Real left, right;
+  double ms;
+  int i, tick;
+
+  if (tilemapGenerate(BENCH_LEVEL, CHUNK_W * 8, 7) != 0 ||
+      tilemapOpen(&map, BENCH_LEVEL) != 0) {
+    printf("Cannot write %s\n", BENCH_LEVEL);
+    remove(BENCH_LEVEL);
+    return 1;
+  }
+
+  /* keep everybody on the chunks a centred view has resident */
+  tilemapStream(&map, 3 * CHUNK_PX, BENCH_VIEW_W);
+  left = realFromInt(2 * CHUNK_PX);
+  right = realFromInt(5 * CHUNK_PX);
+  for (i = 0; i < BENCH_BODIES; i++) {
+    seed = seed * 1664525u + 1013904223u;
+    boxes[i].x = left + realFromInt((int)(seed >> 8) % (3 * CHUNK_PX - 20));
+    boxes[i].y = 0;
+    boxes[i].w = realFromInt(20);
+    boxes[i].h = realFromInt(50);
+    dx[i] = realFromInt(i % 2 ? 3 : -3);
+    dy[i] = 0;
+  }
+
+  start = SDL_GetPerformanceCounter();
+  for (tick = 0; tick < BENCH_TICKS; tick++) {
+    for (i = 0; i < BENCH_BODIES; i++) {
+      int hits;
+
+      dy[i] += REAL(0.5);
+      hits = tilemapMove(&map, &boxes[i], dx[i], dy[i]);
+      if (hits & (TILE_HIT_FLOOR | TILE_HIT_CEILING)) {
+        landings += (hits & TILE_HIT_FLOOR) != 0;
+        dy[i] = (hits & TILE_HIT_FLOOR) && (tick + i) % 50 == 0 ? realFromInt(-8) : 0;
+      }
+      if ((hits & TILE_HIT_WALL) || boxes[i].x < left ||
+          boxes[i].x > right - realFromInt(20)) {
+        walls++;
+        dx[i] = -dx[i];
+      }
+    }
+  }
+  end = SDL_GetPerformanceCounter();
+  ms = elapsedMs(start, end);
+
+  printf("%d bodies x %d ticks: %lu landings, %lu turns\n", BENCH_BODIES,
+         BENCH_TICKS, landings, walls);
+  printf("collision: %.1f ns per body, %.3f ms per tick\n",
+         ms * 1e6 / ((double)BENCH_BODIES * BENCH_TICKS), ms / BENCH_TICKS);
+
+  tilemapClose(&map);
+  remove(BENCH_LEVEL);
+  return 0;
+}
+
+/*
+ * Four emitters firing full radial rings every tick into one pool, the
+ * pool moved and hit-tested against a box like the game does.
+ */
+int benchBullets(void) {
+  static BulletPool pool;
+  Uint64 start, mid, end;
+  double spawnMs = 0, moveMs = 0;
+  unsigned long spawned = 0, moved = 0, hits = 0;
+  int tick, e;
+
+  patternsInit();
+  pool.count = 0;
+
+  for (tick = 0; tick < BENCH_TICKS; tick++) {
+    /* lifetimes outlast the pool at this rate, clear it like a wave end */
+    if (pool.count > BULLET_POOL_MAX - BENCH_EMITTERS * PATTERN_MAX_BULLETS)
+      pool.count = 0;
+
+    start = SDL_GetPerformanceCounter();
+    for (e = 0; e < BENCH_EMITTERS; e++)
+      spawned += (unsigned long)patternFire(
+          &pool, PATTERN_RADIAL, realFromInt(e * 100), realFromInt(120),
+          REAL_ONE, 0);
+    mid = SDL_GetPerformanceCounter();
+    moved += (unsigned long)pool.count;
+    hits += (unsigned long)bulletsMove(&pool, realFromInt(80), realFromInt(100),
+                                       realFromInt(120), realFromInt(150));
+    bulletsRetire(&pool);
+    end = SDL_GetPerformanceCounter();
+    spawnMs += elapsedMs(start, mid);
+    moveMs += elapsedMs(mid, end);
+  }
+
+  printf("%lu bullets spawned over %d ticks (%.0f per tick), "
+         "%.0f live on average, %lu ticks with hits\n",
+         spawned, BENCH_TICKS, (double)spawned / BENCH_TICKS,
+         (double)moved / BENCH_TICKS, hits);
+  printf("spawn: %.1f ns per bullet, move and hit test: %.1f ns per bullet, "
+         "%.3f ms per tick\n",
+         spawnMs * 1e6 / (double)spawned, moveMs * 1e6 / (double)moved,
+         (spawnMs + moveMs) / BENCH_TICKS);
+  return 0;
+}
+
+/* the items 0, 1, 2 ... tagged with the id, waiting out a full ring */
+static int produce(void *data) {
+  RingEnd *end = (RingEnd *)data;
+  Uint32 items[RING_BATCH];
+  int sent = 0;
+  int i, n;
+
+  while (sent < end->items) {
+    n = SDL_min(end->batch, end->items - sent);
+    for (i = 0; i < n; i++)
+      items[i] = end->id << 24 | (Uint32)(sent + i);
+    while (n > 0) {
+      int pushed = end->ring ? ringPush(end->ring, items, n)
+                             : ringMPPush(end->ringMP, items, n);
+      if (pushed == 0) {
+        SDL_Delay(0);
+        continue;
+      }
+      memmove(items, items + pushed, sizeof(Uint32) * (size_t)(n - pushed));
+      n -= pushed;
+      sent += pushed;
+    }
+  }
+  return 0;
+}
+
+/* checks every producer's items arrive whole and in order */
+static int consume(void *data) {
+  RingEnd *end = (RingEnd *)data;
+  Uint32 items[RING_BATCH];
+  Uint32 next[RING_PRODUCERS];
+  int received = 0;
+  int i, n;
+
+  memset(next, 0, sizeof(next));
+  while (received < end->items) {
+    n = end->ring ? ringPop(end->ring, items, end->batch)
+                  : ringMPPop(end->ringMP, items, end->batch);
+    if (n == 0) {
+      SDL_Delay(0);
+      continue;
+    }
+    for (i = 0; i < n; i++) {
+      Uint32 id = items[i] >> 24;
+      if (id >= RING_PRODUCERS || (items[i] & 0xffffff) != next[id]++)
+        end->failures++;
+    }
+    received += n;
+  }
+  return 0;
+}
+
+/* ns per item through the ring, producer threads to this one */
+static double runRing(Ring *ring, RingMP *ringMP, int producers, int batch,
+                      int *failures) {
+  SDL_Thread *threads[RING_PRODUCERS];
+  RingEnd ends[RING_PRODUCERS + 1];
+  Uint64 start;
+  int i;
+
+  memset(ends, 0, sizeof(ends));
+  for (i = 0; i <= producers; i++) {
+    ends[i].ring = ring;
+    ends[i].ringMP = ringMP;
+    ends[i].id = (Uint32)i;
+    ends[i].batch = batch;
+    ends[i].items = RING_ITEMS / producers;
+  }
+  ends[producers].items = RING_ITEMS / producers * producers;
+
+  start = SDL_GetPerformanceCounter();
+  for (i = 0; i < producers; i++)
+    threads[i] = SDL_CreateThread(produce, "producer", &ends[i]);
+  for (i = 0; i < producers; i++) {
+    if (!threads[i]) {
+      printf("Cannot start a producer thread\n");
+      *failures = 1;
+      while (i-- > 0)
+        SDL_WaitThread(threads[i], NULL);
+      return 0;
+    }
+  }
+  consume(&ends[producers]);
+  for (i = 0; i < producers; i++)
+    SDL_WaitThread(threads[i], NULL);
+  *failures = ends[producers].failures;
+  return elapsedMs(start, SDL_GetPerformanceCounter()) * 1e6 /
+         (double)ends[producers].items;
+}
+
+/*
+ * Pushes and pops on one thread, then items through each ring between
+ * threads, one at a time and in batches, checking every one arrives once
+ * and in its producer's order and none is left in the ring. 'make ring-test' runs it under
+ * ThreadSanitizer.
+ */
+int benchRing(void) {
+  static Uint32 slots[RING_SIZE];
+  static SDL_atomic_t published[RING_SIZE];
+  static Ring ring;
+  static RingMP ringMP;
+  Uint32 items[RING_BATCH];
+  Uint64 start;
+  double ns;
+  int failures = 0, f;
+  int batch, i, n;
+
+  for (batch = 1; batch <= RING_BATCH; batch *= RING_BATCH) {
+    ringInit(&ring, slots, sizeof(Uint32), RING_SIZE);
+    for (i = 0; i < batch; i++)
+      items[i] = (Uint32)i;
+    f = 0;
+    start = SDL_GetPerformanceCounter();
+    for (n = 0; n < RING_ITEMS; n += batch) {
+      ringPush(&ring, items, batch);
+      f += ringPop(&ring, items, batch) != batch;
+    }
+    printf("ring, one thread, batches of %d: %.2f ns an item\n", batch,
+           elapsedMs(start, SDL_GetPerformanceCounter()) * 1e6 / RING_ITEMS);
+    failures += f + (ringCount(&ring) != 0);
+  }
+
+  for (batch = 1; batch <= RING_BATCH; batch *= RING_BATCH) {
+    ringInit(&ring, slots, sizeof(Uint32), RING_SIZE);
+    ns = runRing(&ring, NULL, 1, batch, &f);
+    f += ringCount(&ring); /* left behind */
+    printf("ring, two threads, batches of %d: %.2f ns an item, %d wrong\n",
+           batch, ns, f);
+    failures += f;
+
+    ringMPInit(&ringMP, slots, published, sizeof(Uint32), RING_SIZE);
+    ns = runRing(NULL, &ringMP, RING_PRODUCERS, batch, &f);
+    printf("multi-producer ring, %d producers, batches of %d: %.2f ns an "
+           "item, %d wrong\n",
+           RING_PRODUCERS, batch, ns, f);
+    failures += f;
+  }
+  return failures > 0;
+}
+
+/*
+ * The mixer without a device: a burst of sounds queued before each callback,
+ * enough to keep every voice busy and steal, and the callback run by hand.
+ */
+int benchAudio(void) {
+  static const int mixture[16] = {
+      SOUND_SHOT,   SOUND_SHOT,   SOUND_SHOT,   SOUND_SHOT,
+      SOUND_SHOT,   SOUND_SHOT,   SOUND_SHOT,   SOUND_SHOT,
+      SOUND_VOLLEY, SOUND_VOLLEY, SOUND_VOLLEY, SOUND_VOLLEY,
+      SOUND_HIT,    SOUND_HIT,    SOUND_HIT,    SOUND_DEATH};
+  static Sint16 out[AUDIO_FRAMES * 2];
+  SoundPack pack;
+  Uint32 seed = 1;
+  int peak = 0;
+  int n, i;
+
+  if (soundPackOpen(&pack, BENCH_SOUNDS) != 0) {
+    printf("Cannot open %s, make cooks it\n", BENCH_SOUNDS);
+    return 1;
+  }
+  audioInit();
+  audioUsePack(&pack);
+  for (n = 0; n < AUDIO_CALLBACKS; n++) {
+    for (i = 0; i < AUDIO_PLAYS; i++) {
+      int sound;
+
+      /* mostly shots, a death now and then */
+      seed = seed * 1664525u + 1013904223u;
+      sound = mixture[seed >> 28];
+      audioPlay(sound, 0.5f, (float)(seed >> 8 & 0xff) / 128.0f - 1, sound);
+    }
+    audioMix((Uint8 *)out, (int)sizeof(out));
+    for (i = 0; i < AUDIO_FRAMES * 2; i++)
+      peak = SDL_max(peak, SDL_abs(out[i]));
+  }
+  audioPrintStats();
+  printf("audio: peak level %d of 32768\n", peak);
+  soundPackClose(&pack);
+  return peak == 0;
+}
+
+/*
+ * Resident KiB of the mapping holding mapped, -1 where nobody says. The
+ * process-wide RSS counters are updated in batches too coarse for a pack
+ * this size, the mapping's own count is exact.
+ */
+static long residentKb(const void *mapped) {
+  FILE *f = fopen("/proc/self/smaps", "r");
+  char line[256];
+  unsigned long from, to;
+  int inside = 0;
+  long kb = -1;
+
+  if (!f)
+    return -1;
+  while (fgets(line, sizeof(line), f)) {
+    if (sscanf(line, "%lx-%lx ", &from, &to) == 2)
+      inside = (unsigned long)mapped >= from && (unsigned long)mapped < to;
+    else if (inside && strncmp(line, "Rss:", 4) == 0) {
+      kb = atol(line + 4);
+      break;
+    }
+  }
+  fclose(f);
+  return kb;
+}
+
+/* stereo, the way a sound usually arrives before cooking */
+static int writeWav(const char *path, const SoundClip *clip) {
+  SDL_RWops *rw = SDL_RWFromFile(path, "wb");
+  Uint32 bytes = (Uint32)clip->frames * 4;
+  int ok = 1;
+  int i;
+
+  if (!rw)
+    return -1;
+  ok &= SDL_RWwrite(rw, "RIFF", 4, 1) == 1;
+  ok &= SDL_WriteLE32(rw, 36 + bytes) == 1;
+  ok &= SDL_RWwrite(rw, "WAVEfmt ", 8, 1) == 1;
+  ok &= SDL_WriteLE32(rw, 16) == 1;
+  ok &= SDL_WriteLE16(rw, 1) == 1; /* PCM */
+  ok &= SDL_WriteLE16(rw, 2) == 1;
+  ok &= SDL_WriteLE32(rw, AUDIO_RATE) == 1;
+  ok &= SDL_WriteLE32(rw, AUDIO_RATE * 4) == 1;
+  ok &= SDL_WriteLE16(rw, 4) == 1;
+  ok &= SDL_WriteLE16(rw, 16) == 1;
+  ok &= SDL_RWwrite(rw, "data", 4, 1) == 1;
+  ok &= SDL_WriteLE32(rw, bytes) == 1;
+  for (i = 0; i < clip->frames; i++) {
+    ok &= SDL_WriteLE16(rw, (Uint16)clip->samples[i]) == 1;
+    ok &= SDL_WriteLE16(rw, (Uint16)clip->samples[i]) == 1;
+  }
+  SDL_RWclose(rw);
+  return ok ? 0 : -1;
+}
+
+/*
+ * The cooked pack against loading on demand: mapping the pack at startup,
+ * then each sound decoded from a WAV the first time it plays, which is
+ * what the game would do without cooking. Checks both give the same
+ * samples.
+ */
+int benchSounds(void) {
+  SoundPack pack;
+  SoundClip clips[SOUND_COUNT];
+  Sint16 *decoded[SOUND_COUNT];
+  unsigned long heapBytes = 0;
+  Uint64 start;
+  double openMs, loadMs = 0, worstMs = 0;
+  int failures = 0;
+  int i;
+
+  start = SDL_GetPerformanceCounter();
+  if (soundPackOpen(&pack, BENCH_SOUNDS) != 0) {
+    printf("Cannot open %s, make cooks it\n", BENCH_SOUNDS);
+    return 1;
+  }
+  openMs = elapsedMs(start, SDL_GetPerformanceCounter());
+  printf("sounds, cooked pack: %.3f ms to open %lu KiB, %ld KiB resident "
+         "%s, nothing on the heap\n",
+         openMs, (unsigned long)(pack.size / 1024),
+         pack.mapped ? residentKb(pack.mapped) : (long)(pack.size / 1024),
+         pack.mapped ? "from the file" : "read in");
+
+  for (i = 0; i < SOUND_COUNT; i++)
+    if (!soundPackGet(&pack, i, &clips[i])) {
+      printf("%s has no sound %d\n", BENCH_SOUNDS, i);
+      soundPackClose(&pack);
+      return 1;
+    }
+
+  for (i = 0; i < SOUND_COUNT; i++) {
+    int frames = 0;
+    double ms;
+
+    decoded[i] = NULL;
+    if (writeWav(BENCH_WAV, &clips[i]) != 0) {
+      printf("Cannot write %s\n", BENCH_WAV);
+      failures++;
+      continue;
+    }
+    start = SDL_GetPerformanceCounter();
+    if (soundLoadWav(BENCH_WAV, &decoded[i], &frames) != 0) {
+      failures++;
+      continue;
+    }
+    ms = elapsedMs(start, SDL_GetPerformanceCounter());
+    loadMs += ms;
+    worstMs = SDL_max(worstMs, ms);
+    heapBytes += (unsigned long)frames * sizeof(Sint16);
+    if (frames != clips[i].frames ||
+        memcmp(decoded[i], clips[i].samples,
+               (size_t)frames * sizeof(Sint16)) != 0) {
+      printf("sound %s decoded differently\n", clips[i].name);
+      failures++;
+    }
+  }
+  remove(BENCH_WAV);
+  printf("sounds, on demand: %.3f ms to decode %d, %.3f ms the worst first "
+         "play, %lu KiB kept on the heap\n",
+         loadMs, SOUND_COUNT, worstMs, heapBytes / 1024);
+
+  for (i = 0; i < SOUND_COUNT; i++)
+    free(decoded[i]);
+  soundPackClose(&pack);
+  return failures > 0;
+}
+
+/*
+ * The whole horde awake around a player standing on a small level, every
+ * agent patrolling, turning to him and firing, with a stream of his bullets
+ * flying into them through the grid. Agents that die are brought back so
+ * the load stays the same.
+ */
+int benchAi(void) {
+  static Horde horde;
+  static BulletPool shots, theirs;
+  static Grid grid;
+  static FlowField flow;
+  static int killed[AI_MAX];
+  Tilemap map;
+  Real playerX = realFromInt(3 * CHUNK_PX + CHUNK_PX / 2);
+  Real playerY = realFromInt(60); /* about where the ground is */
+  Uint64 start, mid, end;
+  double updateMs = 0, hitMs = 0;
+  unsigned long kills = 0, fired = 0;
+  int tick, i, n;
+
+  if (tilemapGenerate(BENCH_LEVEL, CHUNK_W * 8, 7) != 0 ||
+      tilemapOpen(&map, BENCH_LEVEL) != 0) {
+    printf("Cannot write %s\n", BENCH_LEVEL);
+    remove(BENCH_LEVEL);
+    return 1;
+  }
+  tilemapStream(&map, realToFloat(playerX) - BENCH_VIEW_W / 2, BENCH_VIEW_W);
+
+  flowInit(&flow);
+  aiInit(&horde);
+  for (i = 0; i < AI_MAX; i++)
+    aiSpawn(&horde,
+            playerX + realFromInt(i * 800 / AI_MAX - 400 - BENCH_PATROL / 2),
+            realFromInt(BENCH_PATROL));
+
+  for (tick = 0; tick < BENCH_TICKS; tick++) {
+    for (i = 0; i < BENCH_VOLLEY; i++)
+      bulletAdd(&shots, playerX, playerY + realFromInt(10 + i * 4),
+                realFromInt(tick % 2 ? 3 : -3), 0, 150);
+
+    start = SDL_GetPerformanceCounter();
+    bulletsMove(&shots, 0, 0, 0, 0);
+    gridBuild(&grid, &shots);
+    n = aiHits(&horde, &grid, &shots, killed);
+    bulletsRetire(&shots);
+    mid = SDL_GetPerformanceCounter();
+    flowUpdate(&flow, &map, realToInt(playerX) + 20, realToInt(playerY) + 49);
+    aiUpdate(&horde, &map, &flow, playerX, playerY, &theirs);
+    end = SDL_GetPerformanceCounter();
+    hitMs += elapsedMs(start, mid);
+    updateMs += elapsedMs(mid, end);
+
+    for (i = 0; i < n; i++) {
+      horde.state[killed[i]] = AI_PATROL;
+      horde.life[killed[i]] = AI_LIFE;
+    }
+    kills += (unsigned long)n;
+    fired += (unsigned long)theirs.count;
+    theirs.count = 0;
+  }
+
+  printf("%d agents x %d ticks: %lu killed, %lu shots fired\n", AI_MAX,
+         BENCH_TICKS, kills, fired);
+  printf("ai: %.1f ns per agent, %.3f ms per tick; hits: %.3f ms per tick\n",
+         updateMs * 1e6 / ((double)AI_MAX * BENCH_TICKS),
+         updateMs / BENCH_TICKS, hitMs / BENCH_TICKS);
+  aiPrintStats();
+
+  tilemapClose(&map);
+  remove(BENCH_LEVEL);
+  return 0;
+}
+
+/* an agent falling in somewhere near the player */
+static void dropIn(TileBox *agent, const TileBox *player, Uint32 *seed) {
+  *seed = *seed * 1664525u + 1013904223u;
+  *agent = *player;
+  agent->x += realFromInt((int)(*seed >> 8) % (2 * FLOW_SPREAD) - FLOW_SPREAD);
+  agent->y = 0;
+}
+
+/*
+ * A player walking the 100k tile level with thousands of agents chasing him
+ * down one flow field, each moved against the tiles. The field is rebuilt
+ * only as he changes cells. Agents that catch him, or are left without a
+ * route, drop back in somewhere near him. For comparison, some of them are
+ * timed running a search of their own, what a path per agent would cost.
+ */
+int benchFlow(void) {
+  static TileBox agents[FLOW_AGENTS];
+  static Real dy[FLOW_AGENTS];
+  static FlowField field, own;
+  static int searchX[FLOW_SEARCHES], searchY[FLOW_SEARCHES];
+  Tilemap map;
+  TileBox player;
+  Real playerDy = 0;
+  Real speed = realFromInt(BENCH_SCROLL);
+  Uint32 seed = 1;
+  Uint64 start, mid, end;
+  double flowMs = 0, worstMs = 0, agentMs = 0, searchMs;
+  unsigned long builds = 0, jumps = 0, caught = 0, lost = 0;
+  int tick, hits, i;
+
+  if (tilemapGenerate(BENCH_LEVEL, BENCH_LEVEL_TILES, 1) != 0 ||
+      tilemapOpen(&map, BENCH_LEVEL) != 0) {
+    printf("Cannot write %s\n", BENCH_LEVEL);
+    remove(BENCH_LEVEL);
+    return 1;
+  }
+
+  player.x = realFromInt(4 * CHUNK_PX);
+  player.y = 0;
+  player.w = realFromInt(20);
+  player.h = realFromInt(50);
+  tilemapStream(&map, realToFloat(player.x) - BENCH_VIEW_W / 2, BENCH_VIEW_W);
+  flowInit(&field);
+  for (i = 0; i < FLOW_AGENTS; i++) {
+    dropIn(&agents[i], &player, &seed);
+    dy[i] = 0;
+  }
+
+  for (tick = 0; tick < BENCH_TICKS; tick++) {
+    double ms;
+
+    /* walking right, hopping what he walks into */
+    playerDy += REAL(0.5);
+    hits = tilemapMove(&map, &player, speed, playerDy);
+    if (hits & (TILE_HIT_FLOOR | TILE_HIT_CEILING))
+      playerDy = 0;
+    if ((hits & TILE_HIT_WALL) && playerDy == 0)
+      playerDy = realFromInt(-8);
+    tilemapStream(&map, realToFloat(player.x) - BENCH_VIEW_W / 2,
+                  BENCH_VIEW_W);
+
+    start = SDL_GetPerformanceCounter();
+    builds += (unsigned long)flowUpdate(&field, &map, realToInt(player.x) + 10,
+                                        realToInt(player.y) + 49);
+    mid = SDL_GetPerformanceCounter();
+    for (i = 0; i < FLOW_AGENTS; i++) {
+      int x = realToInt(agents[i].x) + 10, y = realToInt(agents[i].y) + 49;
+      int dist = flowDistance(&field, x, y);
+      int go = flowSample(&field, x, y);
+      Real dx = go & FLOW_GO_LEFT ? -speed : go & FLOW_GO_RIGHT ? speed : 0;
+
+      if (dist <= 4 || dist == FLOW_FAR) {
+        caught += dist <= 4;
+        lost += dist == FLOW_FAR;
+        dropIn(&agents[i], &player, &seed);
+        dy[i] = 0;
+        continue;
+      }
+
+      if ((go & FLOW_GO_UP) && dy[i] == 0) {
+        dy[i] = realFromInt(-8);
+        jumps++;
+      }
+      dy[i] += REAL(0.5);
+      if (tilemapMove(&map, &agents[i], dx, dy[i]) &
+          (TILE_HIT_FLOOR | TILE_HIT_CEILING))
+        dy[i] = 0;
+    }
+    end = SDL_GetPerformanceCounter();
+    ms = elapsedMs(start, mid);
+    flowMs += ms;
+    if (ms > worstMs)
+      worstMs = ms;
+    agentMs += elapsedMs(mid, end);
+  }
+
+  /* where they are now, the build does not touch the agents */
+  for (i = 0; i < FLOW_SEARCHES; i++) {
+    searchX[i] = (realToInt(agents[i].x) + 10) / TILE_SIZE;
+    searchY[i] = (realToInt(agents[i].y) + 49) / TILE_SIZE;
+  }
+  start = SDL_GetPerformanceCounter();
+  for (i = 0; i < FLOW_SEARCHES; i++)
+    flowBuild(&own, &map, searchX[i], searchY[i]);
+  searchMs = elapsedMs(start, SDL_GetPerformanceCounter()) / FLOW_SEARCHES;
+
+  printf("%d agents x %d ticks chasing a player %d pixels along: "
+         "%lu caught him, %lu left without a route, %lu jumps\n",
+         FLOW_AGENTS, BENCH_TICKS, BENCH_TICKS * BENCH_SCROLL, caught, lost,
+         jumps);
+  printf("field: %lu builds, %.1f us each (%.1f worst), %.1f us a tick\n",
+         builds, builds ? flowMs * 1000.0 / (double)builds : 0.0,
+         worstMs * 1000.0, flowMs * 1000.0 / BENCH_TICKS);
+  printf("agents: %.1f ns each to sample and move, %.3f ms per tick\n",
+         agentMs * 1e6 / ((double)FLOW_AGENTS * BENCH_TICKS),
+         agentMs / BENCH_TICKS);
+  printf("a search per agent: %.1f us each, %.1f ms a tick for all of them\n",
+         searchMs * 1000.0, searchMs * FLOW_AGENTS);
+
+  tilemapClose(&map);
+  remove(BENCH_LEVEL);
+  return 0;
+}
+
+/* controlStep() written as the man's steering used to be, to compare */
+static void steerBranches(int count, const Uint8 *buttons, Uint8 *state,
+                          Uint8 *sprite, Sint8 *dx, Uint8 *fired, int tick) {
+  int i;
+
+  for (i = 0; i < count; i++) {
+    int walking = state[i] & CONTROL_WALKING;
+    int shooting = state[i] & CONTROL_SHOOTING;
+    int left = state[i] & CONTROL_LEFT;
+
+    dx[i] = 0;
+    fired[i] = 0;
+    if (!shooting) {
+      if (buttons[i] & INPUT_LEFT) {
+        dx[i] = -3;
+        walking = 1;
+        left = CONTROL_LEFT;
+        if (tick % 6 == 0)
+          sprite[i] = (Uint8)((sprite[i] + 1) % 4);
+      } else if (buttons[i] & INPUT_RIGHT) {
+        dx[i] = 3;
+        walking = 1;
+        left = 0;
+        if (tick % 6 == 0)
+          sprite[i] = (Uint8)((sprite[i] + 1) % 4);
+      } else {
+        walking = 0;
+        sprite[i] = 4;
+      }
+    }
+    if (!walking) {
+      if (buttons[i] & INPUT_FIRE) {
+        if (tick % 6 == 0) {
+          sprite[i] = sprite[i] == 4 ? 5 : 4;
+          fired[i] = 1;
+        }
+        shooting = 1;
+      } else {
+        sprite[i] = 4;
+        shooting = 0;
+      }
+    }
+    state[i] = (Uint8)((walking ? CONTROL_WALKING : 0) |
+                       (shooting ? CONTROL_SHOOTING : 0) | left);
+  }
+}
+
+/*
+ * Thousands of men on random buttons, new ones every tick so no branch
+ * can be guessed, stepped by the control table and by the branches it
+ * replaced. Both have to end up with the same men.
+ */
+int benchControl(void) {
+  static Uint8 buttons[CONTROL_MEN];
+  static Uint8 state[2][CONTROL_MEN], sprite[2][CONTROL_MEN];
+  static Sint8 dx[2][CONTROL_MEN];
+  static Uint8 fired[2][CONTROL_MEN];
+  Uint32 seed = 1;
+  Uint64 start;
+  double tableMs = 0, branchMs = 0;
+  unsigned long shots = 0;
+  int differ = 0;
+  int tick, i;
+
+  for (i = 0; i < CONTROL_MEN; i++)
+    sprite[0][i] = sprite[1][i] = CONTROL_STAND_SPRITE;
+
+  for (tick = 0; tick < BENCH_TICKS; tick++) {
+    for (i = 0; i < CONTROL_MEN; i++) {
+      seed = seed * 1664525u + 1013904223u;
+      buttons[i] = (Uint8)(seed >> 24 &
+                           (INPUT_LEFT | INPUT_RIGHT | INPUT_UP | INPUT_FIRE));
+    }
+
+    start = SDL_GetPerformanceCounter();
+    controlStep(CONTROL_MEN, buttons, state[0], sprite[0], dx[0], fired[0],
+                tick);
+    tableMs += elapsedMs(start, SDL_GetPerformanceCounter());
+    start = SDL_GetPerformanceCounter();
+    steerBranches(CONTROL_MEN, buttons, state[1], sprite[1], dx[1], fired[1],
+                  tick);
+    branchMs += elapsedMs(start, SDL_GetPerformanceCounter());
+
+    for (i = 0; i < CONTROL_MEN; i++) {
+      shots += fired[0][i];
+      differ += state[0][i] != state[1][i] || sprite[0][i] != sprite[1][i] ||
+                dx[0][i] != dx[1][i] || fired[0][i] != fired[1][i];
+    }
+  }
+
+  printf("%d men x %d ticks on random buttons: %lu shots, %d steps differ\n",
+         CONTROL_MEN, BENCH_TICKS, shots, differ);
+  printf("table: %.2f ns a man, branches: %.2f ns a man\n",
+         tableMs * 1e6 / ((double)CONTROL_MEN * BENCH_TICKS),
+         branchMs * 1e6 / ((double)CONTROL_MEN * BENCH_TICKS));
+  return differ != 0;
+}
@@ -0,0 +1,19 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+/*
+ * Offline benchmarks, run with contro --bench-<name>. They print their
+ * numbers and return the process exit status; none of them open a window.
+ */
+
+int benchTilemap(void);
+int benchCollision(void);
+int benchBullets(void);
+int benchRing(void);
+int benchAudio(void);
+int benchSounds(void);
+int benchAi(void);
+int benchFlow(void);
+int benchControl(void);
+
+#endif
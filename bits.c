@@ -0,0 +1,89 @@
+#include "bits.h"
+#include <string.h>
+
+void bitsWriterInit(BitWriter *w, Uint8 *data, int capacity) {
+  w->data = data;
+  w->capacity = capacity;
+  w->pos = 0;
+  w->overflow = 0;
+  memset(data, 0, (size_t)capacity);
+}
+
+/* a byte at a time, the buffer starts out zeroed */
+void bitsWrite(BitWriter *w, Uint32 value, int bits) {
+  if (w->pos + bits > w->capacity * 8) {
+    w->overflow = 1;
+    return;
+  }
+  while (bits > 0) {
+    int shift = w->pos & 7;
+    int n = SDL_min(bits, 8 - shift);
+    w->data[w->pos >> 3] |= (Uint8)((value & ((1u << n) - 1)) << shift);
+    value >>= n;
+    bits -= n;
+    w->pos += n;
+  }
+}
+
+void bitsWriteSigned(BitWriter *w, Sint32 value, int bits) {
+  bitsWrite(w, (Uint32)value & (bits < 32 ? (1u << bits) - 1 : 0xffffffffu),
+            bits);
+}
+
+void bitsWriteGamma(BitWriter *w, Uint32 value) {
+  int n = SDL_MostSignificantBitIndex32(value);
+  bitsWrite(w, 0, n);
+  bitsWrite(w, 1, 1);
+  bitsWrite(w, value & ((1u << n) - 1), n);
+}
+
+int bitsBytes(const BitWriter *w) { return (w->pos + 7) >> 3; }
+
+int bitsLeft(const BitWriter *w) { return w->capacity * 8 - w->pos; }
+
+void bitsReaderInit(BitReader *r, const Uint8 *data, int size) {
+  r->data = data;
+  r->size = size;
+  r->pos = 0;
+  r->overflow = 0;
+}
+
+Uint32 bitsRead(BitReader *r, int bits) {
+  Uint32 value = 0;
+  int done = 0;
+
+  if (r->pos + bits > r->size * 8) {
+    r->overflow = 1;
+    return 0;
+  }
+  while (done < bits) {
+    int shift = r->pos & 7;
+    int n = SDL_min(bits - done, 8 - shift);
+    value |= ((Uint32)r->data[r->pos >> 3] >> shift & ((1u << n) - 1))
+             << done;
+    done += n;
+    r->pos += n;
+  }
+  return value;
+}
+
+Sint32 bitsReadSigned(BitReader *r, int bits) {
+  Uint32 value = bitsRead(r, bits);
+
+  /* sign extend from the top bit of the field */
+  if (bits < 32 && value >> (bits - 1) & 1)
+    value |= ~((1u << bits) - 1);
+  return (Sint32)value;
+}
+
+Uint32 bitsReadGamma(BitReader *r) {
+  int n = 0;
+
+  while (!r->overflow && bitsRead(r, 1) == 0)
+    n++;
+  if (n > 31) {
+    r->overflow = 1;
+    return 1;
+  }
+  return 1u << n | bitsRead(r, n);
+}
@@ -0,0 +1,40 @@
+#ifndef BITS_H
+#define BITS_H
+
+#include <SDL2/SDL.h>
+
+/*
+ * Bit-level packet packing, least significant bit first. Writing past the
+ * end sets overflow and drops the bits; reading past it returns zeros and
+ * sets overflow, so a truncated packet is caught with one check at the
+ * end rather than at every field.
+ */
+
+typedef struct {
+  Uint8 *data;
+  int capacity; /* bytes */
+  int pos;      /* bits */
+  int overflow;
+} BitWriter;
+
+typedef struct {
+  const Uint8 *data;
+  int size; /* bytes */
+  int pos;  /* bits */
+  int overflow;
+} BitReader;
+
+void bitsWriterInit(BitWriter *w, Uint8 *data, int capacity);
+void bitsWrite(BitWriter *w, Uint32 value, int bits); /* bits <= 32 */
+void bitsWriteSigned(BitWriter *w, Sint32 value, int bits);
+/* Elias gamma, small numbers in few bits, value >= 1 */
+void bitsWriteGamma(BitWriter *w, Uint32 value);
+int bitsBytes(const BitWriter *w);
+int bitsLeft(const BitWriter *w);
+
+void bitsReaderInit(BitReader *r, const Uint8 *data, int size);
+Uint32 bitsRead(BitReader *r, int bits);
+Sint32 bitsReadSigned(BitReader *r, int bits);
+Uint32 bitsReadGamma(BitReader *r);
+
+#endif
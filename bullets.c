@@ -0,0 +1,74 @@
+#include "bullets.h"
+
+static int crosses(Real x, Real y, Real dx, Real dy, Real left, Real top,
+                   Real right, Real bottom);
+
+void bulletAdd(BulletPool *pool, Real x, Real y, Real dx, Real dy, int life) {
+  Bullet *b;
+
+  if (pool->count == BULLET_POOL_MAX)
+    return;
+
+  b = &pool->items[pool->count++];
+  b->x = x;
+  b->y = y;
+  b->dx = dx;
+  b->dy = dy;
+  b->life = (Sint16)life;
+  b->serial = pool->nextSerial++;
+}
+
+/*
+ * The hit test is on the segment a bullet sweeps this tick, not on where
+ * it lands, so a bullet faster than the box is wide still hits. It is the
+ * slab test: the segment's entry and exit times through the box on each
+ * axis, intersected with [0, 1]. A zero velocity is replaced by the
+ * smallest one, which puts that axis's times far outside [0, 1] unless the
+ * bullet is already within the slab. Selects only, no branches, so every
+ * bullet costs the same whether it hits or not.
+ */
+static int crosses(Real x, Real y, Real dx, Real dy, Real left, Real top,
+                   Real right, Real bottom) {
+  Real sx = dx != 0 ? dx : REAL_TINY;
+  Real sy = dy != 0 ? dy : REAL_TINY;
+  Real x0 = realDiv(left - x, sx), x1 = realDiv(right - x, sx);
+  Real y0 = realDiv(top - y, sy), y1 = realDiv(bottom - y, sy);
+  Real enter = SDL_max(SDL_max(SDL_min(x0, x1), SDL_min(y0, y1)), 0);
+  Real leave = SDL_min(SDL_min(SDL_max(x0, x1), SDL_max(y0, y1)), REAL_ONE);
+
+  return enter < leave;
+}
+
+int bulletsMove(BulletPool *pool, Real left, Real top, Real right,
+                Real bottom) {
+  int hit = 0;
+  int i;
+
+  for (i = 0; i < pool->count; i++) {
+    Bullet *b = &pool->items[i];
+
+    hit |= crosses(b->x, b->y, b->dx, b->dy, left, top, right, bottom);
+    b->x += b->dx;
+    b->y += b->dy;
+    b->life--;
+  }
+  return hit;
+}
+
+int bulletCrossed(const Bullet *b, Real left, Real top, Real right,
+                  Real bottom) {
+  return crosses(b->x - b->dx, b->y - b->dy, b->dx, b->dy, left, top, right,
+                 bottom);
+}
+
+void bulletsRetire(BulletPool *pool) {
+  int i;
+
+  for (i = 0; i < pool->count;) {
+    if (pool->items[i].life <= 0) {
+      pool->items[i] = pool->items[--pool->count];
+      continue;
+    }
+    i++;
+  }
+}
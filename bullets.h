@@ -0,0 +1,42 @@
+#ifndef BULLETS_H
+#define BULLETS_H
+
+#include "fixed.h"
+#include <SDL2/SDL.h>
+
+/*
+ * Bullet pools. Live bullets are packed at the front of the array, order
+ * does not matter, so removal fills the hole with the last bullet.
+ */
+
+#define BULLET_POOL_MAX 4096
+
+typedef struct {
+  Real x, y, dx, dy;
+  Sint16 life;   /* ticks left */
+  Uint16 serial; /* tells bullets apart over the network, wraps */
+} Bullet;
+
+typedef struct {
+  Bullet items[BULLET_POOL_MAX];
+  int count;
+  Uint16 nextSerial;
+} BulletPool;
+
+void bulletAdd(BulletPool *pool, Real x, Real y, Real dx, Real dy, int life);
+
+/*
+ * Moves every bullet, ages it, and reports whether any of them crossed the
+ * box on the way.
+ */
+int bulletsMove(BulletPool *pool, Real left, Real top, Real right,
+                Real bottom);
+
+/* whether the move bulletsMove() last made the bullet crossed the box */
+int bulletCrossed(const Bullet *b, Real left, Real top, Real right,
+                  Real bottom);
+
+/* drops bullets whose lifetime ran out */
+void bulletsRetire(BulletPool *pool);
+
+#endif
@@ -0,0 +1,66 @@
+#include "control.h"
+#include "input.h"
+
+#define CLIP_WALK 0  /* the four walking frames in turn */
+#define CLIP_STAND 1
+#define CLIP_DRAW 2  /* the first tick of firing, from standing */
+#define CLIP_SHOOT 3 /* the gun frame and standing in turn */
+#define CLIPS 4
+
+typedef struct {
+  Uint8 next;
+  Sint8 dx;
+  Uint8 clip;
+  Uint8 fires; /* on the ticks a frame changes */
+} ControlMove;
+
+#define IDLE(facing) {facing, 0, CLIP_STAND, 0}
+#define LEFT {CONTROL_WALKING | CONTROL_LEFT, -3, CLIP_WALK, 0}
+#define RIGHT {CONTROL_WALKING, 3, CLIP_WALK, 0}
+#define DRAW(facing) {CONTROL_SHOOTING | facing, 0, CLIP_DRAW, 1}
+#define FIRE(facing) {CONTROL_SHOOTING | facing, 0, CLIP_SHOOT, 1}
+#define L CONTROL_LEFT
+
+/*
+ * By state, then by buttons: none, left, right, both, and the same again
+ * with fire. Left wins over right. Walking and shooting at once never
+ * happens, those rows are the shooting ones.
+ */
+static const ControlMove moves[CONTROL_STATES][8] = {
+    {IDLE(0), LEFT, RIGHT, LEFT, DRAW(0), LEFT, RIGHT, LEFT}, /* standing */
+    {IDLE(0), LEFT, RIGHT, LEFT, DRAW(0), LEFT, RIGHT, LEFT}, /* walking */
+    {IDLE(0), IDLE(0), IDLE(0), IDLE(0), FIRE(0), FIRE(0), FIRE(0), FIRE(0)},
+    {IDLE(0), IDLE(0), IDLE(0), IDLE(0), FIRE(0), FIRE(0), FIRE(0), FIRE(0)},
+    {IDLE(L), LEFT, RIGHT, LEFT, DRAW(L), LEFT, RIGHT, LEFT},
+    {IDLE(L), LEFT, RIGHT, LEFT, DRAW(L), LEFT, RIGHT, LEFT},
+    {IDLE(L), IDLE(L), IDLE(L), IDLE(L), FIRE(L), FIRE(L), FIRE(L), FIRE(L)},
+    {IDLE(L), IDLE(L), IDLE(L), IDLE(L), FIRE(L), FIRE(L), FIRE(L), FIRE(L)},
+};
+
+/* clips starting over from the standing frame rather than the current one */
+static const Uint8 clipRestarts[CLIPS] = {0, 1, 1, 0};
+
+void controlStep(int count, const Uint8 *buttons, Uint8 *state, Uint8 *sprite,
+                 Sint8 *dx, Uint8 *fired, int tick) {
+  int turn = tick % CONTROL_FRAME_TICKS == 0;
+  int i;
+
+  for (i = 0; i < count; i++) {
+    int column = (buttons[i] & (INPUT_LEFT | INPUT_RIGHT)) |
+                 ((buttons[i] & INPUT_FIRE) != 0) << 2;
+    const ControlMove *move = &moves[state[i] & (CONTROL_STATES - 1)][column];
+    int from = sprite[i] +
+               clipRestarts[move->clip] * (CONTROL_STAND_SPRITE - sprite[i]);
+    int frames[CLIPS];
+
+    /* every clip's next frame, then the one this move plays */
+    frames[CLIP_WALK] = (from + 1) % 4;
+    frames[CLIP_STAND] = CONTROL_STAND_SPRITE;
+    frames[CLIP_DRAW] = frames[CLIP_SHOOT] =
+        CONTROL_STAND_SPRITE + (from == CONTROL_STAND_SPRITE);
+    sprite[i] = (Uint8)(from + turn * (frames[move->clip] - from));
+    state[i] = move->next;
+    dx[i] = move->dx;
+    fired[i] = (Uint8)(move->fires & turn);
+  }
+}
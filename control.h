@@ -0,0 +1,35 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <SDL2/SDL.h>
+
+/*
+ * Character control as a table. A character's state is three bits, its
+ * buttons pick one of eight columns (left, right, fire), and the entry
+ * gives the next state, the walking speed, the animation clip and whether
+ * it fires. Stepping a character is a few loads and arithmetic, without
+ * branches on the buttons or the state, so controlStep() runs the same
+ * for one player as for thousands of computer controlled men.
+ *
+ * Walking turns the man and stops him firing; firing stops him walking
+ * until the button is let go. Jumping depends on his speed, not on the
+ * state, and is left to the caller.
+ */
+
+#define CONTROL_WALKING 1
+#define CONTROL_SHOOTING 2
+#define CONTROL_LEFT 4 /* facing left */
+#define CONTROL_STATES 8
+
+#define CONTROL_FRAME_TICKS 6 /* ticks each animation frame shows */
+#define CONTROL_STAND_SPRITE 4
+
+/*
+ * Steps count characters one tick. state and sprite are updated in place;
+ * dx gets each one's walking speed in pixels a tick and fired whether it
+ * shot a bullet this tick, along its new facing. buttons are INPUT_ flags.
+ */
+void controlStep(int count, const Uint8 *buttons, Uint8 *state, Uint8 *sprite,
+                 Sint8 *dx, Uint8 *fired, int tick);
+
+#endif
@@ -0,0 +1,111 @@
+#include "emitter.h"
+
+#define FULL_TURN 65536u
+
+static BulletPattern patterns[PATTERN_COUNT];
+static Real turnX[PATTERN_ANGLES], turnY[PATTERN_ANGLES];
+
+static void fan(BulletPattern *pattern, int count, Uint32 spread);
+
+/*
+ * count directions across spread around +x, in 1/65536ths of a turn; a
+ * full turn is a ring
+ */
+static void fan(BulletPattern *pattern, int count, Uint32 spread) {
+  int i;
+
+  pattern->count = count;
+  for (i = 0; i < count; i++) {
+    Uint32 turn = spread >= FULL_TURN || count == 1
+                      ? spread * (Uint32)i / (Uint32)count
+                      : spread * (Uint32)i / (Uint32)(count - 1) - spread / 2;
+    realDirection(turn, &pattern->dirX[i], &pattern->dirY[i]);
+  }
+}
+
+void patternsInit(void) {
+  BulletPattern *p;
+  int i;
+
+  for (i = 0; i < PATTERN_ANGLES; i++)
+    realDirection((Uint32)i * (FULL_TURN / PATTERN_ANGLES), &turnX[i],
+                  &turnY[i]);
+
+  p = &patterns[PATTERN_RADIAL];
+  fan(p, 96, FULL_TURN);
+  p->speed = REAL(1.5);
+  p->interval = 80;
+  p->spin = 1; /* stagger successive rings */
+  p->aimed = 0;
+  p->life = 400;
+
+  p = &patterns[PATTERN_SPIRAL];
+  fan(p, 6, FULL_TURN);
+  p->speed = REAL(2.0);
+  p->interval = 3;
+  p->spin = 5;
+  p->aimed = 0;
+  p->life = 300;
+
+  p = &patterns[PATTERN_AIMED];
+  fan(p, 7, 6258); /* 0.6 radians */
+  p->speed = REAL(3.5);
+  p->interval = 40;
+  p->spin = 0;
+  p->aimed = 1;
+  p->life = 200;
+}
+
+/* the table turned by (rotX, rotY), written in one run into the pool */
+int patternFire(BulletPool *pool, int pattern, Real x, Real y, Real rotX,
+                Real rotY) {
+  const BulletPattern *p = &patterns[pattern];
+  int n = SDL_min(p->count, BULLET_POOL_MAX - pool->count);
+  Bullet *b = &pool->items[pool->count];
+  int i;
+
+  for (i = 0; i < n; i++) {
+    b[i].x = x;
+    b[i].y = y;
+    b[i].dx = realMul(realMul(p->dirX[i], rotX) - realMul(p->dirY[i], rotY),
+                      p->speed);
+    b[i].dy = realMul(realMul(p->dirX[i], rotY) + realMul(p->dirY[i], rotX),
+                      p->speed);
+    b[i].life = (Sint16)p->life;
+    b[i].serial = (Uint16)(pool->nextSerial + i);
+  }
+  pool->count += n;
+  pool->nextSerial = (Uint16)(pool->nextSerial + n);
+  return n;
+}
+
+void emitterStart(Emitter *emitter, int pattern) {
+  emitter->pattern = pattern;
+  emitter->shots = 0;
+  emitter->cooldown = 0;
+}
+
+int emitterUpdate(Emitter *emitter, BulletPool *pool, Real x, Real y,
+                  Real targetX, Real targetY) {
+  const BulletPattern *p = &patterns[emitter->pattern];
+  Real rotX, rotY;
+
+  if (emitter->cooldown > 0) {
+    emitter->cooldown--;
+    return 0;
+  }
+  emitter->cooldown = p->interval - 1;
+
+  if (p->aimed) {
+    rotX = targetX - x;
+    rotY = targetY - y;
+    realNormalize(&rotX, &rotY);
+  } else {
+    int step = emitter->shots % PATTERN_ANGLES * p->spin % PATTERN_ANGLES;
+    rotX = turnX[step];
+    rotY = turnY[step];
+  }
+
+  emitter->shots++;
+  return patternFire(pool, emitter->pattern, x, y, rotX, rotY);
+}
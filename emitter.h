@@ -0,0 +1,51 @@
+#ifndef EMITTER_H
+#define EMITTER_H
+
+#include "bullets.h"
+
+/*
+ * Bullet patterns. Each pattern is a table of unit directions computed once
+ * at start up; a shot rotates the whole table by one unit vector (towards
+ * the target, or by the spiral's current angle) and writes the bullets
+ * straight into the pool. No trigonometry per bullet.
+ */
+
+#define PATTERN_MAX_BULLETS 256
+#define PATTERN_ANGLES 256 /* spiral steps per turn */
+
+#define PATTERN_RADIAL 0
+#define PATTERN_SPIRAL 1
+#define PATTERN_AIMED 2
+#define PATTERN_COUNT 3
+
+typedef struct {
+  int count;    /* bullets per shot */
+  Real speed;   /* pixels per tick */
+  int interval; /* ticks between shots */
+  int spin;     /* angle steps the table turns per shot, spiral */
+  int aimed;    /* turned towards the target */
+  int life;     /* ticks */
+  Real dirX[PATTERN_MAX_BULLETS];
+  Real dirY[PATTERN_MAX_BULLETS];
+} BulletPattern;
+
+typedef struct {
+  int pattern;
+  int shots;
+  int cooldown;
+} Emitter;
+
+/* fills the direction tables, once before any emitter fires */
+void patternsInit(void);
+
+/* one shot of the pattern, returns the number of bullets spawned */
+int patternFire(BulletPool *pool, int pattern, Real x, Real y, Real rotX,
+                Real rotY);
+
+void emitterStart(Emitter *emitter, int pattern);
+
+/* call once per tick, fires when the pattern's interval has passed */
+int emitterUpdate(Emitter *emitter, BulletPool *pool, Real x, Real y,
+                  Real targetX, Real targetY);
+
+#endif
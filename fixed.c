@@ -0,0 +1,119 @@
+#include "fixed.h"
+
+#ifdef FIXED_POINT
+
+#define CORDIC_STEPS 16
+#define CORDIC_GAIN 39797 /* 0.6072529 */
+#define QUARTER_TURN 16384
+#define TWO_PI 411775 /* in 16.16 */
+
+/* atan(2^-i) in 16.16 radians */
+static const Sint32 cordicAngles[CORDIC_STEPS] = {
+    51472, 30386, 16055, 8150, 4091, 2047, 1024, 512,
+    256,   128,   64,    32,   16,   8,    4,    2};
+
+static Uint64 isqrt(Uint64 v);
+
+static Uint64 isqrt(Uint64 v) {
+  Uint64 root = 0;
+  Uint64 bit = (Uint64)1 << 62;
+
+  while (bit > v)
+    bit >>= 2;
+  while (bit) {
+    if (v >= root + bit) {
+      v -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return root;
+}
+
+Real realDiv(Real a, Real b) {
+  Sint64 q = (Sint64)a * REAL_ONE / b;
+
+  if (q > SDL_MAX_SINT32)
+    return SDL_MAX_SINT32;
+  if (q < -SDL_MAX_SINT32)
+    return -SDL_MAX_SINT32;
+  return (Real)q;
+}
+
+void realNormalize(Real *x, Real *y) {
+  Sint64 len = (Sint64)isqrt((Uint64)((Sint64)*x * *x + (Sint64)*y * *y));
+
+  if (len == 0) {
+    *x = REAL_ONE;
+    *y = 0;
+    return;
+  }
+  *x = (Real)((Sint64)*x * REAL_ONE / len);
+  *y = (Real)((Sint64)*y * REAL_ONE / len);
+}
+
+/* CORDIC within the quadrant, integer only, then the quadrant's symmetry */
+void realDirection(Uint32 turn, Real *x, Real *y) {
+  Uint32 quadrant = (turn >> 14) & 3;
+  Sint32 angle = (Sint32)(((Sint64)(turn % QUARTER_TURN) * TWO_PI) >> 16);
+  Sint32 c = CORDIC_GAIN, s = 0;
+  int i;
+
+  for (i = 0; i < CORDIC_STEPS; i++) {
+    Sint32 nc, ns;
+    if (angle >= 0) {
+      nc = c - (s >> i);
+      ns = s + (c >> i);
+      angle -= cordicAngles[i];
+    } else {
+      nc = c + (s >> i);
+      ns = s - (c >> i);
+      angle += cordicAngles[i];
+    }
+    c = nc;
+    s = ns;
+  }
+
+  switch (quadrant) {
+  case 0:
+    *x = c;
+    *y = s;
+    break;
+  case 1:
+    *x = -s;
+    *y = c;
+    break;
+  case 2:
+    *x = -c;
+    *y = -s;
+    break;
+  default:
+    *x = s;
+    *y = -c;
+    break;
+  }
+}
+
+#else
+
+void realNormalize(Real *x, Real *y) {
+  float len = SDL_sqrtf(*x * *x + *y * *y);
+
+  if (len < 0.001f) {
+    *x = 1;
+    *y = 0;
+    return;
+  }
+  *x /= len;
+  *y /= len;
+}
+
+void realDirection(Uint32 turn, Real *x, Real *y) {
+  float a = (float)(2 * M_PI) * (float)(turn & 0xFFFF) / 65536.0f;
+  *x = SDL_cosf(a);
+  *y = SDL_sinf(a);
+}
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef FIXED_H
+#define FIXED_H
+
+#include <SDL2/SDL.h>
+
+/*
+ * The simulation's scalar type. Plain float by default. Built with
+ * -DFIXED_POINT (make FIXED_POINT=1) it is 16.16 fixed point instead, and
+ * a replay then produces the same state bit for bit whatever the compiler
+ * flags or the CPU; -Ofast and FMA contraction are free to change float
+ * results. 16.16 spans +-32767 pixels, which bounds the level width.
+ *
+ * Constants are written REAL(1.5), products realMul(), quotients realDiv().
+ * Rendering and other presentation code converts with realToFloat().
+ */
+
+#ifdef FIXED_POINT
+
+typedef Sint32 Real;
+
+#define REAL_ONE 65536
+#define REAL_TINY 1 /* smallest non-zero magnitude */
+#define REAL(x) ((Real)((x) * 65536.0 + ((x) < 0 ? -0.5 : 0.5)))
+#define realFromInt(i) ((Real)(i) * REAL_ONE)
+#define realToFloat(r) ((float)(r) / 65536.0f)
+#define realToInt(r) ((int)((r) >> 16)) /* rounds down */
+#define realMul(a, b) ((Real)(((Sint64)(a) * (b)) >> 16))
+
+/* saturates instead of overflowing, b must not be 0 */
+Real realDiv(Real a, Real b);
+
+#else
+
+typedef float Real;
+
+#define REAL_ONE 1.0f
+#define REAL_TINY 1e-20f
+#define REAL(x) ((Real)(x))
+#define realFromInt(i) ((Real)(i))
+#define realToFloat(r) (r)
+#define realToInt(r) ((int)SDL_floorf(r))
+#define realMul(a, b) ((a) * (b))
+#define realDiv(a, b) ((a) / (b))
+
+#endif
+
+/* scales (x, y) to unit length, (1, 0) for a zero vector */
+void realNormalize(Real *x, Real *y);
+
+/* unit vector at an angle given in 1/65536ths of a full turn */
+void realDirection(Uint32 turn, Real *x, Real *y);
+
+#endif
@@ -0,0 +1,168 @@
+#include "flow.h"
+#include <stdio.h>
+#include <string.h>
+
+#define CELL_SOLID 1
+#define CELL_CLEAR 2 /* FLOW_HEADROOM empty rows up from here */
+#define CELL_STAND 4 /* clear, on a solid tile */
+
+static unsigned long statBuilds, statKept;
+static double statUs, statWorstUs;
+
+static void readTiles(FlowField *field, const Tilemap *map);
+static void visit(FlowField *field, int *tail, int col, int row, int from,
+                  int move);
+static int cellAt(const FlowField *field, int x, int y);
+
+void flowInit(FlowField *field) {
+  memset(field, 0, sizeof(*field));
+  field->targetX = field->targetY = -1;
+}
+
+/*
+ * The window's tiles once, the search looks at each many times. Chunks the
+ * camera has not loaded are read from the level all the same, the field
+ * only depends on the target and the level.
+ */
+static void readTiles(FlowField *field, const Tilemap *map) {
+  const TileChunk *chunk = NULL;
+  int col, row;
+
+  for (col = 0; col < FLOW_COLS; col++) {
+    int tx = field->left + col;
+    int index = tx < 0 ? -1 : tx / CHUNK_W;
+    int empty = FLOW_HEADROOM; /* rows above the level are open */
+
+    if (!chunk || chunk->index != index)
+      chunk = tilemapPeekChunk(map, index, &field->scratch);
+    for (row = 0; row < FLOW_ROWS; row++) {
+      int solid = index >= 0 && chunk->tiles[row][tx % CHUNK_W] != TILE_EMPTY;
+
+      empty = solid ? 0 : empty + 1;
+      field->cells[row][col] = (Uint8)(solid                     ? CELL_SOLID
+                                       : empty >= FLOW_HEADROOM ? CELL_CLEAR
+                                                                : 0);
+    }
+    /* nothing to stand on below the bottom row */
+    for (row = 0; row < FLOW_ROWS - 1; row++)
+      if ((field->cells[row][col] & CELL_CLEAR) &&
+          (field->cells[row + 1][col] & CELL_SOLID))
+        field->cells[row][col] |= CELL_STAND;
+  }
+}
+
+/* a walker standing at col, row reaches the queued cell from by move */
+static void visit(FlowField *field, int *tail, int col, int row, int from,
+                  int move) {
+  if (!(field->cells[row][col] & CELL_STAND) ||
+      field->dist[row][col] != FLOW_FAR)
+    return;
+  field->dist[row][col] =
+      (Uint16)(field->dist[from / FLOW_COLS][from % FLOW_COLS] + 1);
+  field->moves[row][col] = (Uint8)move;
+  field->queue[(*tail)++] = (Uint16)(row * FLOW_COLS + col);
+}
+
+void flowBuild(FlowField *field, const Tilemap *map, int tx, int ty) {
+  Uint64 start = SDL_GetPerformanceCounter();
+  int head = 0, tail = 0;
+  int col, row, side, k;
+  double us;
+
+  field->left = tx - FLOW_COLS / 2;
+  field->targetX = tx;
+  field->targetY = ty;
+  readTiles(field, map);
+  memset(field->moves, 0, sizeof(field->moves));
+  memset(field->dist, 0xff, sizeof(field->dist));
+
+  /* a target in the air is where it lands */
+  col = tx - field->left;
+  row = SDL_max(ty, 0);
+  while (row < FLOW_ROWS && !(field->cells[row][col] & CELL_STAND) &&
+         !(field->cells[row][col] & CELL_SOLID))
+    row++;
+  if (row < FLOW_ROWS && (field->cells[row][col] & CELL_STAND)) {
+    field->dist[row][col] = 0;
+    field->queue[tail++] = (Uint16)(row * FLOW_COLS + col);
+  }
+
+  /* backwards: who gets to this cell in one move */
+  while (head < tail) {
+    int at = field->queue[head++];
+    int bc = at % FLOW_COLS, br = at / FLOW_COLS;
+
+    for (side = -1; side <= 1; side += 2) {
+      int ac = bc + side;
+      int toward = side < 0 ? FLOW_GO_RIGHT : FLOW_GO_LEFT;
+
+      if (ac < 0 || ac >= FLOW_COLS)
+        continue;
+      /* stepping across at a row this column falls clear from */
+      for (row = br; row >= 0 && (field->cells[row][bc] & CELL_CLEAR); row--)
+        visit(field, &tail, ac, row, at, toward);
+      /* jumping up onto it, from anywhere open below its row */
+      if (field->cells[br][ac] & CELL_CLEAR)
+        for (k = 1; k <= FLOW_JUMP_ROWS && br + k < FLOW_ROWS &&
+                    !(field->cells[br + k][ac] & CELL_SOLID);
+             k++)
+          visit(field, &tail, ac, br + k, at, toward | FLOW_GO_UP);
+    }
+  }
+
+  /* air takes the move of where it lands, bottom up */
+  for (col = 0; col < FLOW_COLS; col++)
+    for (row = FLOW_ROWS - 2; row >= 0; row--)
+      if (!(field->cells[row][col] & (CELL_SOLID | CELL_STAND)) &&
+          !(field->cells[row + 1][col] & CELL_SOLID)) {
+        field->moves[row][col] = field->moves[row + 1][col];
+        field->dist[row][col] = field->dist[row + 1][col];
+      }
+
+  us = (double)(SDL_GetPerformanceCounter() - start) * 1e6 /
+       (double)SDL_GetPerformanceFrequency();
+  statBuilds++;
+  statUs += us;
+  if (us > statWorstUs)
+    statWorstUs = us;
+}
+
+int flowUpdate(FlowField *field, const Tilemap *map, int x, int y) {
+  int tx = x / TILE_SIZE, ty = y / TILE_SIZE;
+
+  if (tx == field->targetX && ty == field->targetY) {
+    statKept++;
+    return 0;
+  }
+  flowBuild(field, map, tx, ty);
+  return 1;
+}
+
+/* index into the arrays, -1 off the field */
+static int cellAt(const FlowField *field, int x, int y) {
+  int col = (x < 0 ? -1 : x / TILE_SIZE) - field->left;
+  int row = y < 0 ? 0 : y / TILE_SIZE;
+
+  if (field->targetX < 0 || col < 0 || col >= FLOW_COLS || row >= FLOW_ROWS)
+    return -1;
+  return row * FLOW_COLS + col;
+}
+
+int flowSample(const FlowField *field, int x, int y) {
+  int at = cellAt(field, x, y);
+
+  return at < 0 ? 0 : field->moves[at / FLOW_COLS][at % FLOW_COLS];
+}
+
+int flowDistance(const FlowField *field, int x, int y) {
+  int at = cellAt(field, x, y);
+
+  return at < 0 ? FLOW_FAR : field->dist[at / FLOW_COLS][at % FLOW_COLS];
+}
+
+void flowPrintStats(void) {
+  if (statBuilds == 0)
+    return;
+  printf("flow: %lu builds, %.1f us each (%.1f worst), kept %lu times\n",
+         statBuilds, statUs / (double)statBuilds, statWorstUs, statKept);
+}
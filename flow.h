@@ -0,0 +1,65 @@
+#ifndef FLOW_H
+#define FLOW_H
+
+#include "tilemap.h"
+
+/*
+ * A flow field toward one target, shared by every agent chasing it, over
+ * the FLOW_COLS columns of tiles around the target. It is a breadth first
+ * search from the target cell backwards along the moves a walker can make:
+ * a step left or right, dropping as far as it falls, or jumping up to
+ * FLOW_JUMP_ROWS onto the next column. That takes a second jump from the
+ * top of the first, where dy is 0 again, as the man can; the air over the
+ * take off says to jump. Each cell keeps the first move of its shortest
+ * route, so following the field is one lookup per agent per tick whatever
+ * the number of agents.
+ *
+ * Cells are tiles, an agent is in the cell under the middle of its feet.
+ * Cells in the air take the move of where they land, so falling agents
+ * already know where to go. The field is only rebuilt when the target
+ * changes cells. It reads the level's tiles whether or not the camera has
+ * streamed them in, so it only depends on the target and the level and is
+ * not part of snapshots; restoring one just calls flowInit() to rebuild.
+ */
+
+#define FLOW_COLS 128     /* 2048 pixels, past where agents are awake */
+#define FLOW_ROWS CHUNK_H
+#define FLOW_HEADROOM 4   /* rows of empty tiles a walker stands in */
+#define FLOW_JUMP_ROWS 7  /* 112 pixels, two jumps reach 120 */
+#define FLOW_FAR 0xffff   /* no route to the target */
+
+/* flowSample() moves */
+#define FLOW_GO_LEFT 1
+#define FLOW_GO_RIGHT 2
+#define FLOW_GO_UP 4 /* jump, standing */
+
+typedef struct {
+  int left;               /* first column of the field */
+  int targetX, targetY;   /* cell, -1 before the first build */
+  Uint8 cells[FLOW_ROWS][FLOW_COLS];  /* what a walker can do there */
+  Uint8 moves[FLOW_ROWS][FLOW_COLS];  /* FLOW_GO_ flags */
+  Uint16 dist[FLOW_ROWS][FLOW_COLS];  /* moves to the target */
+  Uint16 queue[FLOW_ROWS * FLOW_COLS];
+  TileChunk scratch;      /* chunks read past the resident ones */
+} FlowField;
+
+void flowInit(FlowField *field);
+
+/*
+ * Points the field at the target's feet, in pixels, rebuilding it if the
+ * target changed cells. Returns 1 if rebuilt.
+ */
+int flowUpdate(FlowField *field, const Tilemap *map, int x, int y);
+
+/* the search itself, from cell tx, ty, whether or not anything changed */
+void flowBuild(FlowField *field, const Tilemap *map, int tx, int ty);
+
+/* FLOW_GO_ flags for feet at x, y in pixels, 0 at the target or off it */
+int flowSample(const FlowField *field, int x, int y);
+
+/* moves from feet at x, y to the target, FLOW_FAR without a route */
+int flowDistance(const FlowField *field, int x, int y);
+
+void flowPrintStats(void);
+
+#endif
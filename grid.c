@@ -0,0 +1,64 @@
+#include "grid.h"
+#include <string.h>
+
+static int cellX(int x);
+static int cellY(int y);
+static int cellOf(const Bullet *b);
+
+static int cellX(int x) {
+  return SDL_max(0, SDL_min(x >> GRID_CELL_SHIFT, GRID_COLUMNS - 1));
+}
+
+static int cellY(int y) {
+  return SDL_max(0,
+                 SDL_min((y - GRID_TOP) >> GRID_CELL_SHIFT, GRID_ROWS - 1));
+}
+
+static int cellOf(const Bullet *b) {
+  return cellY(realToInt(b->y)) * GRID_COLUMNS + cellX(realToInt(b->x));
+}
+
+void gridBuild(Grid *grid, const BulletPool *pool) {
+  int i;
+
+  /* count per cell, then each cell's end, then fill back to front */
+  memset(grid->start, 0, sizeof(grid->start));
+  for (i = 0; i < pool->count; i++)
+    grid->start[cellOf(&pool->items[i]) + 1]++;
+  for (i = 0; i < GRID_COLUMNS * GRID_ROWS; i++)
+    grid->start[i + 1] += grid->start[i];
+  for (i = pool->count - 1; i >= 0; i--) {
+    const Bullet *b = &pool->items[i];
+    GridItem *item = &grid->items[--grid->start[cellOf(b) + 1]];
+    item->x = b->x;
+    item->y = b->y;
+    item->index = (Uint16)i;
+    item->serial = b->serial;
+  }
+  /* start[cell + 1] counted back down to where the cell begins */
+  for (i = 0; i < GRID_COLUMNS * GRID_ROWS; i++)
+    grid->start[i] = grid->start[i + 1];
+  grid->start[GRID_COLUMNS * GRID_ROWS] = pool->count;
+}
+
+int gridQuery(const Grid *grid, int left, int top, int right, int bottom,
+              Uint16 *out) {
+  Real l = realFromInt(left), t = realFromInt(top);
+  Real r = realFromInt(right), b = realFromInt(bottom);
+  int x0 = cellX(left), x1 = cellX(right);
+  int y0 = cellY(top), y1 = cellY(bottom);
+  int n = 0;
+  int x, y, i;
+
+  for (y = y0; y <= y1; y++) {
+    for (x = x0; x <= x1; x++) {
+      int cell = y * GRID_COLUMNS + x;
+      for (i = grid->start[cell]; i < grid->start[cell + 1]; i++) {
+        const GridItem *item = &grid->items[i];
+        if (item->x >= l && item->x < r && item->y >= t && item->y < b)
+          out[n++] = (Uint16)i;
+      }
+    }
+  }
+  return n;
+}
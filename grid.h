@@ -0,0 +1,36 @@
+#ifndef GRID_H
+#define GRID_H
+
+#include "bullets.h"
+
+/*
+ * A uniform grid over the bullets of one pool, rebuilt from scratch each
+ * tick with a counting sort into a copy of what queries need, grouped by
+ * cell: a box query reads only the cells it overlaps, front to back,
+ * without touching the pool. Bullets off the grid count as being in its
+ * edge cells.
+ */
+
+#define GRID_CELL_SHIFT 6 /* 64 pixel cells */
+#define GRID_COLUMNS 512  /* 32768 pixels, as far as 16.16 reaches */
+#define GRID_ROWS 16
+#define GRID_TOP (-384) /* pixels, bullets fly well above the level */
+
+typedef struct {
+  Real x, y;
+  Uint16 index; /* in the pool */
+  Uint16 serial;
+} GridItem;
+
+typedef struct {
+  int start[GRID_COLUMNS * GRID_ROWS + 1]; /* first item of each cell */
+  GridItem items[BULLET_POOL_MAX];         /* by cell */
+} Grid;
+
+void gridBuild(Grid *grid, const BulletPool *pool);
+
+/* the items inside the box, in pixels, as indices into items; how many */
+int gridQuery(const Grid *grid, int left, int top, int right, int bottom,
+              Uint16 *out);
+
+#endif
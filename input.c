@@ -0,0 +1,89 @@
+#include "input.h"
+#include "latency.h"
+#include "ring.h"
+
+/*
+ * Single producer (the event watch, called from whichever thread pumps SDL
+ * events) and single consumer (the simulation tick).
+ */
+static InputEdge edges[INPUT_QUEUE_SIZE];
+static Ring queue;
+static SDL_atomic_t dropped;
+static Uint8 held;
+
+static Uint8 buttonFor(SDL_Scancode code);
+static void pushEdge(Uint32 timestamp, Uint8 button, Uint8 down);
+static int watchKeys(void *userdata, SDL_Event *event);
+
+static Uint8 buttonFor(SDL_Scancode code) {
+  if (code == SDL_SCANCODE_LEFT)
+    return INPUT_LEFT;
+  if (code == SDL_SCANCODE_RIGHT)
+    return INPUT_RIGHT;
+  if (code == SDL_SCANCODE_UP)
+    return INPUT_UP;
+  if (code == SDL_SCANCODE_SPACE)
+    return INPUT_FIRE;
+  return 0;
+}
+
+static void pushEdge(Uint32 timestamp, Uint8 button, Uint8 down) {
+  InputEdge edge;
+
+  edge.timestamp = timestamp;
+  edge.button = button;
+  edge.down = down;
+  if (ringPush(&queue, &edge, 1) == 0)
+    SDL_AtomicAdd(&dropped, 1);
+}
+
+static int watchKeys(void *userdata, SDL_Event *event) {
+  Uint8 button;
+
+  (void)userdata;
+  if ((event->type != SDL_KEYDOWN && event->type != SDL_KEYUP) ||
+      event->key.repeat)
+    return 0;
+
+  button = buttonFor(event->key.keysym.scancode);
+  if (button)
+    pushEdge(event->key.timestamp, button, event->type == SDL_KEYDOWN);
+  return 0;
+}
+
+void inputStart(void) {
+  ringInit(&queue, edges, sizeof(InputEdge), INPUT_QUEUE_SIZE);
+  SDL_AtomicSet(&dropped, 0);
+  held = 0;
+  SDL_AddEventWatch(watchKeys, NULL);
+}
+
+void inputStop(void) { SDL_DelEventWatch(watchKeys, NULL); }
+
+TickInput inputTick(Uint32 tickEnd) {
+  TickInput input;
+  const InputEdge *edge;
+
+  input.pressed = 0;
+  while ((edge = (const InputEdge *)ringPeek(&queue)) != NULL) {
+    /* stamped after this tick: leave it for the tick it belongs to */
+    if ((Sint32)(edge->timestamp - tickEnd) > 0)
+      break;
+
+    if (edge->down) {
+      held = (Uint8)(held | edge->button);
+      input.pressed = (Uint8)(input.pressed | edge->button);
+    } else {
+      held = (Uint8)(held & ~edge->button);
+    }
+    latencyInputEdge(edge->timestamp);
+    ringPop(&queue, NULL, 1);
+  }
+
+  input.held = held;
+  return input;
+}
+
+unsigned long inputDropped(void) {
+  return (unsigned long)SDL_AtomicGet(&dropped);
+}
@@ -0,0 +1,41 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <SDL2/SDL.h>
+
+/*
+ * Event-driven input. Key edges are captured by an SDL event watch the
+ * moment SDL pumps them and pushed, timestamped, into a lock-free queue.
+ * The fixed-rate simulation drains the queue one tick at a time, taking
+ * only the edges stamped before the end of that tick, so a tap shorter
+ * than a frame still registers and lands on the right tick.
+ */
+
+#define INPUT_LEFT 0x01
+#define INPUT_RIGHT 0x02
+#define INPUT_UP 0x04
+#define INPUT_FIRE 0x08
+
+#define INPUT_QUEUE_SIZE 256 /* power of two */
+
+typedef struct {
+  Uint32 timestamp; /* SDL_GetTicks() milliseconds */
+  Uint8 button;     /* one INPUT_* bit */
+  Uint8 down;
+} InputEdge;
+
+typedef struct {
+  Uint8 held;    /* buttons down at the end of the tick */
+  Uint8 pressed; /* went down during the tick, even if released again */
+} TickInput;
+
+void inputStart(void);
+void inputStop(void);
+
+/* consumes every queued edge stamped at or before tickEnd */
+TickInput inputTick(Uint32 tickEnd);
+
+/* edges lost to a full queue since inputStart() */
+unsigned long inputDropped(void);
+
+#endif
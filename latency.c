@@ -0,0 +1,103 @@
+#include "latency.h"
+#include <stdio.h>
+
+#define MAX_PENDING 32
+
+static unsigned long histogram[LATENCY_BUCKETS];
+static unsigned long samples;
+static Uint64 pending[MAX_PENDING];
+static int pendingCount;
+
+void latencyInputEdge(Uint32 eventTimestamp) {
+  Uint64 now = SDL_GetPerformanceCounter();
+  Uint64 age;
+
+  if (pendingCount == MAX_PENDING)
+    return;
+
+  /*
+   * SDL stamps events in SDL_GetTicks() milliseconds; move the stamp into
+   * the performance counter domain so the present side can be precise
+   */
+  age = (Uint64)(SDL_GetTicks() - eventTimestamp) *
+        SDL_GetPerformanceFrequency() / 1000;
+  pending[pendingCount++] = now > age ? now - age : 0;
+}
+
+void latencyPresented(void) {
+  Uint64 now = SDL_GetPerformanceCounter();
+  double ticksPerMs = (double)SDL_GetPerformanceFrequency() / 1000.0;
+  int i;
+
+  for (i = 0; i < pendingCount; i++) {
+    double ms = (double)(now - pending[i]) / ticksPerMs;
+    int bucket = (int)(ms / LATENCY_BUCKET_MS);
+
+    if (bucket >= LATENCY_BUCKETS)
+      bucket = LATENCY_BUCKETS - 1;
+    histogram[bucket]++;
+    samples++;
+  }
+  pendingCount = 0;
+}
+
+double latencyPercentile(double percentile) {
+  unsigned long rank;
+  unsigned long seen = 0;
+  int i;
+
+  if (samples == 0)
+    return 0.0;
+
+  rank = (unsigned long)((double)samples * percentile / 100.0);
+  if (rank >= samples)
+    rank = samples - 1;
+
+  for (i = 0; i < LATENCY_BUCKETS; i++) {
+    seen += histogram[i];
+    if (seen > rank)
+      break;
+  }
+
+  /* report the bucket's upper edge, never flatter the numbers */
+  return (double)(i + 1) * LATENCY_BUCKET_MS;
+}
+
+unsigned long latencySamples(void) { return samples; }
+
+void latencyPrint(void) {
+  if (samples == 0)
+    return;
+  printf("input latency (%lu edges): p50 %.1f ms, p95 %.1f ms, p99 %.1f ms\n",
+         samples, latencyPercentile(50.0), latencyPercentile(95.0),
+         latencyPercentile(99.0));
+}
+
+/* three bars along the top, 2 px per millisecond: p50, p95, p99 */
+void latencyDrawOverlay(SDL_Renderer *renderer) {
+  static const Uint8 colors[3][3] = {{0, 255, 0}, {255, 255, 0}, {255, 0, 0}};
+  static const double percentiles[3] = {50.0, 95.0, 99.0};
+  int i;
+
+  for (i = 0; i < 3; i++) {
+    SDL_Rect bar;
+
+    bar.x = 4;
+    bar.y = 4 + i * 5;
+    bar.w = (int)(latencyPercentile(percentiles[i]) * 2.0);
+    bar.h = 3;
+    SDL_SetRenderDrawColor(renderer, colors[i][0], colors[i][1], colors[i][2],
+                           255);
+    SDL_RenderFillRect(renderer, &bar);
+  }
+}
+
+void latencyShowInTitle(SDL_Window *window) {
+  char title[128];
+
+  SDL_snprintf(title, sizeof(title),
+               "Game Window - input latency p50 %.1f / p95 %.1f / p99 %.1f ms",
+               latencyPercentile(50.0), latencyPercentile(95.0),
+               latencyPercentile(99.0));
+  SDL_SetWindowTitle(window, title);
+}
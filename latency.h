@@ -0,0 +1,27 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <SDL2/SDL.h>
+
+/*
+ * Input-to-present latency. Every key edge is tagged with its SDL event
+ * timestamp when it is polled; the next SDL_RenderPresent, which is the
+ * first frame that can show its effect, closes the measurement. Samples go
+ * into a fixed histogram so recording never allocates.
+ */
+
+#define LATENCY_BUCKET_MS 0.5
+#define LATENCY_BUCKETS 200 /* last bucket also counts everything slower */
+
+void latencyInputEdge(Uint32 eventTimestamp);
+void latencyPresented(void);
+
+/* percentile in [0, 100], result in milliseconds */
+double latencyPercentile(double percentile);
+unsigned long latencySamples(void);
+
+void latencyPrint(void);
+void latencyDrawOverlay(SDL_Renderer *renderer);
+void latencyShowInTitle(SDL_Window *window);
+
+#endif
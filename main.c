@@ -1,65 +1,291 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
 #include <stdio.h>
-
-#define MAX_BULLETS 1000
-
+#include <stdlib.h>
+#include <string.h>
+
+#include "ai.h"
+#include "arena.h"
+#include "assetpack.h"
+#include "assetwatch.h"
+#include "audio.h"
+#include "bench.h"
+#include "bullets.h"
+#include "control.h"
+#include "emitter.h"
+#include "flow.h"
+#include "grid.h"
+#include "input.h"
+#include "latency.h"
+#include "memtrack.h"
+#include "net.h"
+#include "parallax.h"
+#include "particles.h"
+#include "replicate.h"
+#include "rollback.h"
+#include "server.h"
+#include "snapshot.h"
+#include "texcache.h"
+#include "tilemap.h"
+
+#define FRAME_ARENA_SIZE (512 * 1024)
+#define SCREEN_W 320
+#define SCREEN_H 240
+#define TEXTURE_BUDGET (16 * 1024 * 1024)
+#define TICK_MS 10        /* fixed simulation rate, 100 Hz */
+#define MAX_CATCH_UP 5    /* ticks run per frame before dropping behind */
+#define REPLAY_TICKS 3000
+#define BULLET_LIFE 333  /* ticks, about 1000 pixels for the player's gun */
+#define PATTERN_TICKS 500 /* the enemy switches patterns this often */
+#define MAN_BOX_X 10 /* collision box inside the 40x50 sprite frame */
+#define MAN_BOX_W 20
+#define MAN_BOX_H 50
+#define QUICKSAVE "quicksave.snp"
+#define SNAPSHOT_BENCH_RUNS 10000
+#define NETPLAY_TICKS 1000  /* --versus-bot runs this long */
+#define NETPLAY_LINGER 1000 /* ms of answering the peer after that */
+#define NETPLAY_TIMEOUT 30000
+#define VERSUS_LIFE 100 /* ticks under fire before going back to the start */
+#define SERVER_TURRETS 8 /* default extra emitters for --server */
+#define SERVER_TURRETS_MAX 32
+#define TURRET_SPACING 160
+#define CLIENT_TIMEOUT 30000 /* ms of waiting for the server or the clients */
+#define SMOOTHING 0.85f /* of a correction still showing a tick later */
+#define HORDE_START 400 /* pixels, past where the man starts */
+#define HORDE_SPACING 120
+#define HORDE_PATROL 96
+
+/* plain values only, snapshots copy it as is */
 typedef struct {
-  float x, y, dy;
-  short life;
-  char *name;
-  int currentSprite, walking, facingLeft, shooting, visible;
+  Real x, y, dx, dy;
+  int life;
+  int currentSprite, visible;
+  int state; /* CONTROL_ bits */
   int alive;
-  SDL_Texture *sheetTexture;
+  int sheetTexture;
 } Man;
 
+/* the man run ahead of a --server from the client's own inputs */
 typedef struct {
-  float x, y, dx;
-} Bullet;
-
-SDL_Texture *bulletTexture;
-SDL_Texture *backgroundTexture;
-Bullet *bullets[MAX_BULLETS];
+  Man states[REPL_INPUTS]; /* after each input, by number */
+  int synced;              /* since the first state from the server */
+  Uint32 checked;          /* tick of the newest snapshot compared */
+  float errorX, errorY;    /* of corrections, eased out when drawing */
+  unsigned long checks, corrections;
+  float worstError;
+} Prediction;
+
+AssetPack assets;
+SoundPack sounds;
+TexCache textures;
+int bulletTexture;
+int backgroundTexture;
+BulletPool bullets;
+BulletPool enemyBullets;
+BulletPool rivalBullets;
 Man enemy;
+Man rival; /* the second player in versus play */
+Emitter enemyGun;
+Horde horde;
+FlowField flow; /* toward the man, for the horde */
+Grid hordeGrid; /* the man's bullets, for hitting the horde */
+Tilemap level;
+Snapshot quickSave;
+NetLink netLink;
+Rollback netplay;
+int versusSide = -1; /* the player this side controls, -1 playing alone */
+ReplClient remote;
+Prediction prediction;
+int remotePlay = 0; /* the world comes from a --server */
+float cameraX; /* left edge of the view in world pixels */
 
 int globalTime = 0;
-
-void addBullet(float x, float y, float dx);
-void removeBullet(int i);
+int showOverlay = 0;
+
+#ifdef EMBED_ASSETS
+/* assets.pak linked into .rodata by the Makefile, see assets_pak.o */
+#ifdef __cplusplus
+extern "C" {
+#endif
+extern const Uint8 _binary_assets_pak_start[];
+extern const Uint8 _binary_assets_pak_end[];
+#ifdef __cplusplus
+}
+#endif
+#endif
+
+void initActors(Man *man);
+void openAssets(void);
+int openLevel(const char *name);
+int openSounds(void);
+void spawnHorde(void);
+int viewLeft(const Man *man);
+float panAt(Real x);
+void updateCamera(const Man *man);
+int moveMan(Man *man, Real dx, Real dy);
+void updateMan(Man *man);
+int shootMan(BulletPool *pool, const Man *man);
 int processEvents(SDL_Window *window, Man *man);
+void steerMan(Man *man, TickInput input, BulletPool *gun);
+void applyInput(Man *man, TickInput input);
+TickInput replayInput(int tick);
+void drawBullets(SDL_Renderer *renderer, const BulletPool *pool);
+void drawMan(SDL_Renderer *renderer, const Man *man, float dx, float dy);
+void drawHorde(SDL_Renderer *renderer);
 void doRender(SDL_Renderer *renderer, Man *man);
+void updateWorld(Man *man);
 void updateLogic(Man *man);
+void updateVersus(Man *man, const TickInput inputs[2], int replaying);
+void saveWorld(Snapshot *snap, const Man *man);
+int restoreWorld(const Snapshot *snap, Man *man);
+int startReplay(Man *man);
+int replayChecksum(void);
+int benchSnapshot(void);
+void netSave(void *context, Snapshot *snap);
+void netLoad(void *context, const Snapshot *snap);
+void netAdvance(void *context, const TickInput inputs[2], int replaying);
+int startVersus(Man *man, int argc, char *argv[]);
+int versusBot(int argc, char *argv[]);
+void captureActors(const Man *man, ReplActor actors[REPL_ACTORS]);
+void showActor(const ReplActor *actor, Man *man);
+void captureOwner(const Man *man, ReplOwner *owner);
+void showOwner(const ReplOwner *owner, Man *man);
+int predicted(const Man *man, const ReplOwner *owner);
+void reconcile(Prediction *pred, const ReplClient *repl, Man *man);
+void predict(Prediction *pred, const ReplClient *repl, Man *man);
+int runServer(int argc, char *argv[]);
+int serverClients(int argc, char *argv[]);
+int startClient(int argc, char *argv[]);
+void clientTick(Man *man, TickInput input);
+
+/* the player and the enemy as a level starts */
+void initActors(Man *man) {
+  memset(man, 0, sizeof(*man));
+  man->x = realFromInt(50);
+  man->y = 0;
+  man->currentSprite = 4;
+  man->alive = 1;
+  man->visible = 1;
+  man->state = 0; /* standing, facing right */
+
+  enemy.x = realFromInt(250);
+  enemy.currentSprite = 4;
+  enemy.state = CONTROL_LEFT;
+  enemy.alive = 1;
+  enemy.visible = 1;
+}
 
-void addBullet(float x, float y, float dx) {
-  int found = -1;
-  int i;
-  for (i = 0; i < MAX_BULLETS; i++) {
-    if (bullets[i] == NULL) {
-      found = i;
-      break;
-    }
+/*
+ * Finds the cooked asset pack: linked into the binary when built with
+ * EMBED_ASSETS, otherwise assets.pak next to the binary or in the working
+ * directory. Without any pack the texture cache decodes the PNGs itself.
+ */
+void openAssets(void) {
+  char *base;
+
+#ifdef EMBED_ASSETS
+  if (assetPackOpenMemory(&assets, _binary_assets_pak_start,
+                          (size_t)(_binary_assets_pak_end -
+                                   _binary_assets_pak_start)) == 0)
+    return;
+#endif
+
+  base = SDL_GetBasePath();
+  if (base) {
+    char path[512];
+    SDL_snprintf(path, sizeof(path), "%sassets.pak", base);
+    SDL_free(base);
+    if (assetPackOpenFile(&assets, path) == 0)
+      return;
   }
+  assetPackOpenFile(&assets, "assets.pak");
+}
 
-  if (found >= 0) {
-    i = found;
-    bullets[i] = (Bullet *)malloc(sizeof(Bullet));
-    bullets[i]->x = x;
-    bullets[i]->y = y;
-    bullets[i]->dx = dx;
+/* the level streams from disk, next to the binary or in the working dir */
+int openLevel(const char *name) {
+  char *base = SDL_GetBasePath();
+
+  if (base) {
+    char path[512];
+    SDL_snprintf(path, sizeof(path), "%s%s", base, name);
+    SDL_free(base);
+    if (tilemapOpen(&level, path) == 0)
+      return 0;
   }
+  return tilemapOpen(&level, name);
 }
 
-void removeBullet(int i) {
-  if (bullets[i]) {
-    free(bullets[i]);
-    bullets[i] = NULL;
+/* mapped for the life of the game, next to the binary or in the working dir */
+int openSounds(void) {
+  char *base = SDL_GetBasePath();
+
+  if (base) {
+    char path[512];
+    SDL_snprintf(path, sizeof(path), "%ssounds.pak", base);
+    SDL_free(base);
+    if (soundPackOpen(&sounds, path) == 0)
+      return 0;
   }
+  return soundPackOpen(&sounds, "sounds.pak");
 }
 
+/* agents along the level past the start, each patrolling its own stretch */
+void spawnHorde(void) {
+  int end = tilemapWidthPx(&level) - HORDE_PATROL - 40;
+  int x;
+
+  aiInit(&horde);
+  flowInit(&flow);
+  for (x = HORDE_START; x < end; x += HORDE_SPACING)
+    if (aiSpawn(&horde, realFromInt(x), realFromInt(HORDE_PATROL)) < 0)
+      break;
+}
+
+/*
+ * The view keeping the man centred, stopping at the level edges. It snaps to
+ * whole pixels: views decide which chunks are resident, so they are part of
+ * the simulation and must not depend on float rounding.
+ */
+int viewLeft(const Man *man) {
+  int maxX = tilemapWidthPx(&level) - SCREEN_W;
+  int x = realToInt(man->x) + 20 - SCREEN_W / 2;
+
+  if (x > maxX)
+    x = maxX;
+  if (x < 0)
+    x = 0;
+  return x;
+}
+
+/* -1 at the left edge of the view to 1 at the right, for a man at x */
+float panAt(Real x) {
+  return (realToFloat(x) + 20 - cameraX) / (SCREEN_W / 2) - 1;
+}
+
+void updateCamera(const Man *man) {
+  cameraX = (float)viewLeft(man);
+  tilemapStream(&level, cameraX, SCREEN_W);
+}
+
+/* sweeps the man's box through the tiles, returns the TILE_HIT_ flags */
+int moveMan(Man *man, Real dx, Real dy) {
+  TileBox box;
+  int hits;
+
+  box.x = man->x + realFromInt(MAN_BOX_X);
+  box.y = man->y;
+  box.w = realFromInt(MAN_BOX_W);
+  box.h = realFromInt(MAN_BOX_H);
+  hits = tilemapMove(&level, &box, dx, dy);
+  man->x = box.x - realFromInt(MAN_BOX_X);
+  man->y = box.y;
+  return hits;
+}
+
+/* window and system events only, game keys arrive through the input queue */
 int processEvents(SDL_Window *window, Man *man) {
   SDL_Event event;
   int done = 0;
-  const Uint8 *state;
 
   while (SDL_PollEvent(&event)) {
     switch (event.type) {
@@ -75,10 +301,29 @@ int processEvents(SDL_Window *window, Man *man) {
       case SDLK_ESCAPE:
         done = 1;
         break;
+      case SDLK_F1:
+        showOverlay = !showOverlay;
+        break;
+      case SDLK_F5:
+        saveWorld(&quickSave, man);
+        if (snapshotWrite(&quickSave, QUICKSAVE) != 0)
+          printf("Cannot write %s\n", QUICKSAVE);
+        break;
+      case SDLK_F9:
+        if (versusSide >= 0 || remotePlay)
+          break; /* the peer or the server would not load it */
+        if (snapshotRead(&quickSave, QUICKSAVE) != 0 ||
+            restoreWorld(&quickSave, man) != 0)
+          printf("Cannot load %s\n", QUICKSAVE);
+        break;
       default:
         break;
       }
     } break;
+    case SDL_RENDER_TARGETS_RESET:
+      /* render target contents are lost, the parallax caches with them */
+      parallaxInvalidate();
+      break;
     case SDL_QUIT:
       /* quit out of the game */
       done = 1;
@@ -88,67 +333,131 @@ int processEvents(SDL_Window *window, Man *man) {
     }
   }
 
-  state = SDL_GetKeyboardState(NULL);
-  if (!man->shooting) {
-    if (state[SDL_SCANCODE_LEFT]) {
-      man->x -= 3;
-      man->walking = 1;
-      man->facingLeft = 1;
+  return done;
+}
 
-      if (globalTime % 6 == 0) {
-        man->currentSprite++;
-        man->currentSprite %= 4;
-      }
-    } else if (state[SDL_SCANCODE_RIGHT]) {
-      man->x += 3;
-      man->walking = 1;
-      man->facingLeft = 0;
-
-      if (globalTime % 6 == 0) {
-        man->currentSprite++;
-        man->currentSprite %= 4;
-      }
-    } else {
-      man->walking = 0;
-      man->currentSprite = 4;
-    }
+/* walking, shooting into gun and jumping; without a gun nothing is fired */
+void steerMan(Man *man, TickInput input, BulletPool *gun) {
+  /* a tap that was already released still counts for its tick */
+  Uint8 buttons = (Uint8)(input.held | input.pressed);
+  Uint8 state = (Uint8)man->state;
+  Uint8 sprite = (Uint8)man->currentSprite;
+  Sint8 dx;
+  Uint8 fired;
+  int left;
+
+  controlStep(1, &buttons, &state, &sprite, &dx, &fired, globalTime);
+  man->state = state;
+  man->currentSprite = sprite;
+  man->dx = realFromInt(dx);
+  /* only from standing, where dy is exactly 0 */
+  man->dy -= realFromInt(8 * (((buttons & INPUT_UP) != 0) & (man->dy == 0)));
+
+  if (fired && gun) {
+    left = (state & CONTROL_LEFT) != 0;
+    bulletAdd(gun, man->x + realFromInt(35 - 30 * left),
+              man->y + realFromInt(20), realFromInt(3 - 6 * left), 0,
+              BULLET_LIFE);
+    particleEmit(PARTICLE_MUZZLE, realToFloat(man->x) + (float)(38 - 36 * left),
+                 realToFloat(man->y) + 22, (float)(1 - 2 * left), 6);
+    audioPlay(SOUND_SHOT, 0.4f, panAt(man->x), 1);
   }
+}
 
-  if (!man->walking) {
-    if (state[SDL_SCANCODE_SPACE]) /* && !man->dy) */
-    {
-      if (globalTime % 6 == 0) {
-        if (man->currentSprite == 4)
-          man->currentSprite = 5;
-        else
-          man->currentSprite = 4;
+void applyInput(Man *man, TickInput input) {
+  steerMan(man, input, man == &rival ? &rivalBullets : &bullets);
+}
 
-        if (!man->facingLeft) {
-          addBullet(man->x + 35, man->y + 20, 3);
-        } else {
-          addBullet(man->x + 5, man->y + 20, -3);
-        }
-      }
+/* scripted input for --replay-fire: sustained fire, hops and turns */
+TickInput replayInput(int tick) {
+  TickInput input;
+
+  input.held = INPUT_FIRE;
+  input.pressed = 0;
+  if (tick % 300 < 30)
+    input.held |= (Uint8)((tick / 300) % 2 ? INPUT_LEFT : INPUT_RIGHT);
+  if (tick % 45 == 0)
+    input.pressed = INPUT_UP;
+  return input;
+}
 
-      man->shooting = 1;
-    } else {
-      man->currentSprite = 4;
-      man->shooting = 0;
-    }
-  }
+/* cull into a draw list in the frame arena, then draw it */
+void drawBullets(SDL_Renderer *renderer, const BulletPool *pool) {
+  SDL_Rect *rects;
+  SDL_Texture *texture = texCacheGet(&textures, bulletTexture);
+  int count = 0;
+  int i;
 
-  if (state[SDL_SCANCODE_UP] && !man->dy) {
-    man->dy = -8;
-  }
-  if (state[SDL_SCANCODE_DOWN]) {
-    /* man->y += 10; */
+  rects = (SDL_Rect *)frameAlloc(sizeof(SDL_Rect) * (size_t)pool->count);
+  if (!rects)
+    return;
+
+  for (i = 0; i < pool->count; i++) {
+    const Bullet *b = &pool->items[i];
+    float x = realToFloat(b->x) - cameraX;
+    float y = realToFloat(b->y);
+    if (x < -8 || x > SCREEN_W || y < -8 || y > SCREEN_H)
+      continue;
+    rects[count].x = (int)x;
+    rects[count].y = (int)y;
+    rects[count].w = 8;
+    rects[count].h = 8;
+    count++;
   }
 
-  return done;
+  for (i = 0; i < count; i++)
+    SDL_RenderCopy(renderer, texture, NULL, &rects[i]);
 }
 
-void doRender(SDL_Renderer *renderer, Man *man) {
+/* dx, dy shift the sprite off the man's position */
+void drawMan(SDL_Renderer *renderer, const Man *man, float dx, float dy) {
+  SDL_Rect srcRect;
+  SDL_Rect rect;
+
+  if (!man->visible)
+    return;
+
+  srcRect.x = 40 * man->currentSprite;
+  srcRect.y = 0;
+  srcRect.w = 40;
+  srcRect.h = 50;
+
+  rect.x = (int)(realToFloat(man->x) + dx - cameraX);
+  rect.y = (int)(realToFloat(man->y) + dy);
+  rect.w = 40;
+  rect.h = 50;
+  SDL_RenderCopyEx(renderer, texCacheGet(&textures, man->sheetTexture),
+                   &srcRect, &rect, 0, NULL,
+                   (SDL_RendererFlip)((man->state & CONTROL_LEFT) != 0));
+}
+
+/* the agents in view, with the enemy's sheet */
+void drawHorde(SDL_Renderer *renderer) {
+  SDL_Texture *sheet = texCacheGet(&textures, enemy.sheetTexture);
+  SDL_Rect srcRect;
+  SDL_Rect rect;
   int i;
+
+  srcRect.y = 0;
+  srcRect.w = 40;
+  srcRect.h = 50;
+  rect.w = 40;
+  rect.h = 50;
+  for (i = 0; i < horde.count; i++) {
+    float x = realToFloat(horde.x[i]) - cameraX;
+    int sprite = aiSprite(&horde, i, globalTime);
+
+    if (sprite < 0 || x <= -40 || x >= SCREEN_W)
+      continue;
+    srcRect.x = 40 * sprite;
+    rect.x = (int)x;
+    rect.y = (int)realToFloat(horde.y[i]);
+    SDL_RenderCopyEx(renderer, sheet, &srcRect, &rect, 0, NULL,
+                     (SDL_RendererFlip)horde.facingLeft[i]);
+  }
+}
+
+void doRender(SDL_Renderer *renderer, Man *man) {
   /* set the drawing color to blue */
   SDL_SetRenderDrawColor(renderer, 0, 0, 255, 255);
 
@@ -159,24 +468,20 @@ void doRender(SDL_Renderer *renderer, Man *man) {
   SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
 
   /* SDL_RenderFillRect(renderer, &rect); */
-  SDL_RenderCopy(renderer, backgroundTexture, NULL, NULL);
-
-  /* warrior */
-  if (man->visible) {
-    SDL_Rect srcRect;
-    SDL_Rect rect;
-
-    srcRect.x = 40 * man->currentSprite;
-    srcRect.y = 0;
-    srcRect.w = 40;
-    srcRect.h = 50;
-
-    rect.x = (int)man->x;
-    rect.y = (int)man->y;
-    rect.w = 40;
-    rect.h = 50;
-    SDL_RenderCopyEx(renderer, man->sheetTexture, &srcRect, &rect, 0, NULL,
-                     (SDL_RendererFlip)man->facingLeft);
+  SDL_RenderCopy(renderer, texCacheGet(&textures, backgroundTexture), NULL,
+                 NULL);
+
+  parallaxDraw(renderer, cameraX);
+  tilemapDraw(&level, renderer, cameraX, SCREEN_W, SCREEN_H);
+
+  /* warriors, the second player tinted, a predicted man easing out of
+   * corrections */
+  drawMan(renderer, man, prediction.errorX, prediction.errorY);
+  if (rival.visible) {
+    SDL_Texture *sheet = texCacheGet(&textures, rival.sheetTexture);
+    SDL_SetTextureColorMod(sheet, 255, 150, 150);
+    drawMan(renderer, &rival, 0, 0);
+    SDL_SetTextureColorMod(sheet, 255, 255, 255);
   }
 
   /* enemy */
@@ -184,58 +489,117 @@ void doRender(SDL_Renderer *renderer, Man *man) {
     SDL_Rect eSrcRect;
     SDL_Rect eRect;
 
-    eSrcRect.x = 40 * 40 * enemy.currentSprite;
+    eSrcRect.x = 40 * enemy.currentSprite;
     eSrcRect.y = 0;
     eSrcRect.w = 40;
     eSrcRect.h = 50;
 
-    eRect.x = (int)enemy.x;
-    eRect.y = (int)enemy.y;
+    eRect.x = (int)(realToFloat(enemy.x) - cameraX);
+    eRect.y = (int)realToFloat(enemy.y);
     eRect.w = 40;
     eRect.h = 50;
 
-    SDL_RenderCopyEx(renderer, enemy.sheetTexture, &eSrcRect, &eRect, 0, NULL,
-                     (SDL_RendererFlip)enemy.facingLeft);
+    SDL_RenderCopyEx(renderer, texCacheGet(&textures, enemy.sheetTexture),
+                     &eSrcRect, &eRect, 0, NULL,
+                     (SDL_RendererFlip)((enemy.state & CONTROL_LEFT) != 0));
   }
+  drawHorde(renderer);
 
-  for (i = 0; i < MAX_BULLETS; i++)
-    if (bullets[i]) {
-      SDL_Rect rect;
+  drawBullets(renderer, &bullets);
+  drawBullets(renderer, &enemyBullets);
+  drawBullets(renderer, &rivalBullets);
 
-      rect.x = (int)bullets[i]->x;
-      rect.y = (int)bullets[i]->y;
-      rect.w = 8;
-      rect.h = 8;
+  particlesDraw(renderer, cameraX);
 
-      SDL_RenderCopy(renderer, bulletTexture, NULL, &rect);
-    }
+  if (showOverlay)
+    latencyDrawOverlay(renderer);
 
   /* We are done drawing, "present" or show to the screen what we've drawn */
   SDL_RenderPresent(renderer);
+
+  /* first frame showing this tick's input, close its latency samples */
+  latencyPresented();
 }
 
-void updateLogic(Man *man) {
-  int i;
-  man->y += man->dy;
-  man->dy += 0.5f;
-  if (man->y > 60) {
-    man->y = 60;
+/* gravity, tiles and the level edges */
+void updateMan(Man *man) {
+  Real maxX = realFromInt(tilemapWidthPx(&level) - 40);
+
+  /* gravity first, so standing still keeps dy at 0 for the jump test */
+  man->dy += REAL(0.5);
+  if (moveMan(man, man->dx, man->dy) & (TILE_HIT_FLOOR | TILE_HIT_CEILING))
     man->dy = 0;
-  }
 
-  for (i = 0; i < MAX_BULLETS; i++)
-    if (bullets[i]) {
-      bullets[i]->x += bullets[i]->dx;
+  if (man->x < 0)
+    man->x = 0;
+  if (man->x > maxX)
+    man->x = maxX;
+}
 
-      /* simple coll. detection */
-      if (bullets[i]->x > enemy.x && bullets[i]->x < enemy.x + 40 &&
-          bullets[i]->y > enemy.y && bullets[i]->y < enemy.y + 50) {
-        enemy.alive = 0;
-      }
+/* moves the pool's bullets, sparks where they hit the man */
+int shootMan(BulletPool *pool, const Man *man) {
+  int hit = bulletsMove(pool, man->x + realFromInt(MAN_BOX_X), man->y,
+                        man->x + realFromInt(MAN_BOX_X + MAN_BOX_W),
+                        man->y + realFromInt(MAN_BOX_H));
+  if (hit) {
+    particleEmit(PARTICLE_SPARK, realToFloat(man->x) + 20,
+                 realToFloat(man->y) + 22, 0, 2);
+    audioPlay(SOUND_HIT, 0.6f, panAt(man->x), 2);
+  }
+  bulletsRetire(pool);
+  return hit;
+}
 
-      if (bullets[i]->x < -1000 || bullets[i]->x > 1000)
-        removeBullet(i);
+/* everything but the man's own movement */
+void updateWorld(Man *man) {
+  static int killed[AI_MAX];
+  float ex = realToFloat(enemy.x);
+  float ey = realToFloat(enemy.y);
+  int kills, i;
+
+  if (bulletsMove(&bullets, enemy.x, enemy.y, enemy.x + realFromInt(40),
+                  enemy.y + realFromInt(50)) &&
+      enemy.visible) {
+    /* sparks fly back towards the shooter, debris once on the kill */
+    float side = man->x < enemy.x ? -1.0f : 1.0f;
+    particleEmit(PARTICLE_SPARK, ex + 20 + side * 12,
+                 realToFloat(man->y) + 22, side, 3);
+    audioPlay(SOUND_HIT, 0.6f, panAt(enemy.x), 2);
+    if (enemy.alive) {
+      particleEmit(PARTICLE_DEBRIS, ex + 20, ey + 25, 0, 64);
+      audioPlay(SOUND_DEATH, 1.0f, panAt(enemy.x), 3);
     }
+    enemy.alive = 0;
+  }
+  /* what is left of them goes through the horde */
+  if (bullets.count > 0 && horde.count > 0) {
+    gridBuild(&hordeGrid, &bullets);
+    kills = aiHits(&horde, &hordeGrid, &bullets, killed);
+    for (i = 0; i < kills; i++) {
+      Real x = horde.x[killed[i]];
+      particleEmit(PARTICLE_DEBRIS, realToFloat(x) + 20,
+                   realToFloat(horde.y[killed[i]]) + 25, 0, 32);
+      audioPlay(SOUND_DEATH, 1.0f, panAt(x), 3);
+    }
+  }
+  bulletsRetire(&bullets);
+
+  /* the enemy cycles through its patterns for as long as it lives */
+  if (enemy.alive) {
+    if (globalTime % PATTERN_TICKS == 0)
+      emitterStart(&enemyGun, globalTime / PATTERN_TICKS % PATTERN_COUNT);
+    if (emitterUpdate(&enemyGun, &enemyBullets, enemy.x + realFromInt(20),
+                      enemy.y + realFromInt(25), man->x + realFromInt(20),
+                      man->y + realFromInt(25)) > 0)
+      audioPlay(SOUND_VOLLEY, 0.3f, panAt(enemy.x), 0);
+  }
+  if (horde.count > 0)
+    flowUpdate(&flow, &level, realToInt(man->x) + 20,
+               realToInt(man->y) + MAN_BOX_H - 1);
+  aiUpdate(&horde, &level, &flow, man->x, man->y, &enemyBullets);
+  shootMan(&enemyBullets, man);
+
+  particlesUpdate();
 
   if (enemy.alive == 0 && globalTime % 6 == 0) {
     if (enemy.currentSprite < 6)
@@ -252,31 +616,772 @@ void updateLogic(Man *man) {
   globalTime++;
 }
 
-int main(void) {
+void updateLogic(Man *man) {
+  updateMan(man);
+  updateWorld(man);
+}
+
+/*
+ * One tick of versus play: both players move and each one's bullets hit the
+ * other, the enemy sits out. Chunks are streamed around both players first,
+ * collision must not depend on whose screen this runs on.
+ */
+void updateVersus(Man *man, const TickInput inputs[2], int replaying) {
+  Man *players[2];
+  int i;
+
+  players[0] = man;
+  players[1] = &rival;
+  particlesMute(replaying);
+  audioMute(replaying);
+  for (i = 0; i < 2; i++) {
+    tilemapStream(&level, (float)viewLeft(players[i]), SCREEN_W);
+    applyInput(players[i], inputs[i]);
+    updateMan(players[i]);
+  }
+
+  if (shootMan(&bullets, &rival))
+    rival.life--;
+  if (shootMan(&rivalBullets, man))
+    man->life--;
+  for (i = 0; i < 2; i++) {
+    if (players[i]->life > 0)
+      continue;
+    players[i]->x = realFromInt(i == 0 ? 50 : 250);
+    players[i]->y = 0;
+    players[i]->dy = 0;
+    players[i]->life = VERSUS_LIFE;
+  }
+
+  if (!replaying)
+    particlesUpdate();
+  particlesMute(0);
+  audioMute(0);
+  globalTime++;
+}
+
+/* everything the simulation owns; particles are presentation only */
+void saveWorld(Snapshot *snap, const Man *man) {
+  snapshotBegin(snap, (Uint32)globalTime);
+  snapshotPut(snap, man, sizeof(*man));
+  snapshotPut(snap, &enemy, sizeof(enemy));
+  snapshotPut(snap, &rival, sizeof(rival));
+  snapshotPut(snap, &enemyGun, sizeof(enemyGun));
+  snapshotPut(snap, &horde, sizeof(horde));
+  snapshotPutPool(snap, &bullets);
+  snapshotPutPool(snap, &enemyBullets);
+  snapshotPutPool(snap, &rivalBullets);
+}
+
+int restoreWorld(const Snapshot *snap, Man *man) {
+  size_t pos = 0;
+
+  if (snapshotGet(snap, &pos, man, sizeof(*man)) != 0 ||
+      snapshotGet(snap, &pos, &enemy, sizeof(enemy)) != 0 ||
+      snapshotGet(snap, &pos, &rival, sizeof(rival)) != 0 ||
+      snapshotGet(snap, &pos, &enemyGun, sizeof(enemyGun)) != 0 ||
+      snapshotGet(snap, &pos, &horde, sizeof(horde)) != 0 ||
+      snapshotGetPool(snap, &pos, &bullets) != 0 ||
+      snapshotGetPool(snap, &pos, &enemyBullets) != 0 ||
+      snapshotGetPool(snap, &pos, &rivalBullets) != 0)
+    return -1;
+  globalTime = (int)snap->tick;
+  flowInit(&flow); /* rebuilt toward the restored man */
+  updateCamera(man);
+  return 0;
+}
+
+/* the level and actors of the headless modes, no window or textures */
+int startReplay(Man *man) {
+  initActors(man);
+  if (openLevel("level1.lvl") != 0) {
+    printf("Cannot find level1.lvl\n");
+    return -1;
+  }
+  updateCamera(man);
+  moveMan(&enemy, 0, realFromInt(SCREEN_H));
+  spawnHorde();
+  patternsInit();
+  return 0;
+}
+
+/*
+ * --replay-checksum: the --replay-fire script run headless, then a hash of
+ * the world snapshot. Built with FIXED_POINT=1 every target prints the same
+ * line, which is what the determinism target in the Makefile checks.
+ */
+int replayChecksum(void) {
+  static Snapshot snap;
+  Man man;
+
+  if (startReplay(&man) != 0)
+    return 1;
+  while (globalTime < REPLAY_TICKS) {
+    applyInput(&man, replayInput(globalTime));
+    updateLogic(&man);
+    updateCamera(&man);
+  }
+  saveWorld(&snap, &man);
+  tilemapClose(&level);
+
+  printf("man at %.2f,%.2f, %d player and %d enemy bullets\n",
+         (double)realToFloat(man.x), (double)realToFloat(man.y),
+         bullets.count, enemyBullets.count);
+  printf("checksum %08lx after %d ticks\n", (unsigned long)snapshotHash(&snap),
+         globalTime);
+  return 0;
+}
+
+/*
+ * --bench-snapshot: save and restore timings for the replay scene and for
+ * both bullet pools full, and a check that a restored world replays to the
+ * same state as the original run.
+ */
+int benchSnapshot(void) {
+  static Snapshot snap, after;
+  Man man;
+  Uint64 start, end;
+  double saveUs, restoreUs;
+  int scene, i;
+
+  if (startReplay(&man) != 0)
+    return 1;
+  while (globalTime < REPLAY_TICKS / 10) {
+    applyInput(&man, replayInput(globalTime));
+    updateLogic(&man);
+    updateCamera(&man);
+  }
+
+  for (scene = 0; scene < 2; scene++) {
+    if (scene == 1) {
+      /* worst case, every bullet slot in use */
+      while (bullets.count < BULLET_POOL_MAX)
+        bulletAdd(&bullets, man.x, man.y, realFromInt(3), 0, BULLET_LIFE);
+      while (enemyBullets.count < BULLET_POOL_MAX)
+        bulletAdd(&enemyBullets, enemy.x, enemy.y, realFromInt(-3), 0,
+                  BULLET_LIFE);
+    }
+
+    start = SDL_GetPerformanceCounter();
+    for (i = 0; i < SNAPSHOT_BENCH_RUNS; i++)
+      saveWorld(&snap, &man);
+    end = SDL_GetPerformanceCounter();
+    saveUs = (double)(end - start) * 1e6 /
+             (double)SDL_GetPerformanceFrequency() / SNAPSHOT_BENCH_RUNS;
+
+    start = SDL_GetPerformanceCounter();
+    for (i = 0; i < SNAPSHOT_BENCH_RUNS; i++)
+      restoreWorld(&snap, &man);
+    end = SDL_GetPerformanceCounter();
+    restoreUs = (double)(end - start) * 1e6 /
+                (double)SDL_GetPerformanceFrequency() / SNAPSHOT_BENCH_RUNS;
+
+    printf("%s: %d bullets, %lu bytes, save %.2f us, restore %.2f us\n",
+           scene == 0 ? "replay scene" : "full pools",
+           bullets.count + enemyBullets.count, (unsigned long)snap.size,
+           saveUs, restoreUs);
+  }
+
+  /* run on from the snapshot twice, both runs must end up identical */
+  for (i = 0; i < 2; i++) {
+    restoreWorld(&snap, &man);
+    while (globalTime < (int)snap.tick + 500) {
+      applyInput(&man, replayInput(globalTime));
+      updateLogic(&man);
+      updateCamera(&man);
+    }
+    if (i == 0)
+      saveWorld(&after, &man);
+  }
+  saveWorld(&snap, &man);
+  tilemapClose(&level);
+
+  if (snapshotHash(&snap) != snapshotHash(&after)) {
+    printf("restored world diverged: %08lx != %08lx\n",
+           (unsigned long)snapshotHash(&snap),
+           (unsigned long)snapshotHash(&after));
+    return 1;
+  }
+  printf("restored world replays identically\n");
+  return 0;
+}
+
+/* the rollback session's view of the game, context is the first player */
+void netSave(void *context, Snapshot *snap) {
+  saveWorld(snap, (const Man *)context);
+}
+
+void netLoad(void *context, const Snapshot *snap) {
+  restoreWorld(snap, (Man *)context);
+}
+
+void netAdvance(void *context, const TickInput inputs[2], int replaying) {
+  updateVersus((Man *)context, inputs, replaying);
+}
+
+/*
+ * --versus <port> <peer port> [latency ms] [jitter ms] [loss %]: two player
+ * rollback play against another copy on this machine, with the outgoing
+ * packets put through the given network conditions. The lower port plays
+ * the first player; man is always the first player, rival the second.
+ */
+int startVersus(Man *man, int argc, char *argv[]) {
+  NetConditions conditions;
+  RollbackGame game;
+  int port, peer;
+
+  if (argc < 4) {
+    printf("usage: %s %s <port> <peer port> [latency ms] [jitter ms] "
+           "[loss %%]\n",
+           argv[0], argv[1]);
+    return -1;
+  }
+  port = SDL_atoi(argv[2]);
+  peer = SDL_atoi(argv[3]);
+  conditions.latencyMs = argc > 4 ? SDL_atoi(argv[4]) : 0;
+  conditions.jitterMs = argc > 5 ? SDL_atoi(argv[5]) : 0;
+  conditions.lossPercent = argc > 6 ? SDL_atoi(argv[6]) : 0;
+  if (netOpen(&netLink, (Uint16)port, (Uint16)peer, &conditions) != 0) {
+    printf("Cannot open UDP port %d\n", port);
+    return -1;
+  }
+  versusSide = port < peer ? 0 : 1;
+
+  rival = *man;
+  rival.x = realFromInt(250);
+  rival.state |= CONTROL_LEFT;
+  man->life = VERSUS_LIFE;
+  rival.life = VERSUS_LIFE;
+  enemy.alive = 0;
+  enemy.visible = 0;
+  horde.count = 0;
+
+  game.context = man;
+  game.save = netSave;
+  game.load = netLoad;
+  game.advance = netAdvance;
+  rollbackStart(&netplay, &game, &netLink, versusSide);
+  return 0;
+}
+
+/*
+ * --versus-bot: --versus without a window, on scripted input, for
+ * NETPLAY_TICKS. It then answers the peer until both sides hold every
+ * input and prints a checksum of the final tick, which has to come out the
+ * same on both peers whatever the network did. See 'make netplay-test'.
+ */
+int versusBot(int argc, char *argv[]) {
+  static Snapshot snap;
+  Man man;
+  Uint32 start, nextTick, now, lingerUntil = 0;
+
+  if (startReplay(&man) != 0 || startVersus(&man, argc, argv) != 0)
+    return 1;
+
+  start = nextTick = SDL_GetTicks();
+  for (;;) {
+    if (netplay.tick < NETPLAY_TICKS) {
+      /* the second player runs the script half a loop later */
+      rollbackTick(&netplay,
+                   replayInput((int)netplay.tick + versusSide * 150));
+    } else {
+      rollbackPoll(&netplay);
+      if (!lingerUntil && netplay.remoteTick >= NETPLAY_TICKS &&
+          netplay.remoteAck >= NETPLAY_TICKS)
+        lingerUntil = SDL_GetTicks() + NETPLAY_LINGER;
+      if (lingerUntil && (Sint32)(SDL_GetTicks() - lingerUntil) >= 0)
+        break;
+    }
+
+    nextTick += TICK_MS;
+    now = SDL_GetTicks();
+    if (now - start > NETPLAY_TIMEOUT) {
+      printf("peer timed out at tick %lu\n", (unsigned long)netplay.tick);
+      netClose(&netLink);
+      tilemapClose(&level);
+      return 1;
+    }
+    if ((Sint32)(nextTick - now) > 0)
+      SDL_Delay(nextTick - now);
+  }
+
+  saveWorld(&snap, &man);
+  netClose(&netLink);
+  tilemapClose(&level);
+
+  rollbackPrintStats(&netplay);
+  printf("life left: player 1 %d, player 2 %d\n", man.life, rival.life);
+  printf("checksum %08lx after %d ticks\n", (unsigned long)snapshotHash(&snap),
+         globalTime);
+  return 0;
+}
+
+/* the actors as replicated: the man, the enemy and the rival */
+void captureActors(const Man *man, ReplActor actors[REPL_ACTORS]) {
+  const Man *all[REPL_ACTORS];
+  int i;
+
+  all[0] = man;
+  all[1] = &enemy;
+  all[2] = &rival;
+  for (i = 0; i < REPL_ACTORS; i++) {
+    actors[i].x = replQuantize(all[i]->x, REPL_POS_SHIFT);
+    actors[i].y = replQuantize(all[i]->y, REPL_POS_SHIFT);
+    actors[i].sprite = all[i]->currentSprite & 7;
+    actors[i].flags = (all[i]->visible ? REPL_VISIBLE : 0) |
+                      (all[i]->state & CONTROL_LEFT ? REPL_FACING_LEFT : 0) |
+                      (all[i]->alive ? REPL_ALIVE : 0);
+  }
+}
+
+/* what drawing needs of a replicated actor */
+void showActor(const ReplActor *actor, Man *man) {
+  man->x = replDequantize(actor->x, REPL_POS_SHIFT);
+  man->y = replDequantize(actor->y, REPL_POS_SHIFT);
+  man->currentSprite = actor->sprite;
+  man->visible = (actor->flags & REPL_VISIBLE) != 0;
+  man->state = (man->state & ~CONTROL_LEFT) |
+               (actor->flags & REPL_FACING_LEFT ? CONTROL_LEFT : 0);
+  man->alive = (actor->flags & REPL_ALIVE) != 0;
+}
+
+/* what the man's next steps depend on, exactly */
+void captureOwner(const Man *man, ReplOwner *owner) {
+  owner->input = 0;
+  owner->x = replRealBits(man->x);
+  owner->y = replRealBits(man->y);
+  owner->dx = replRealBits(man->dx);
+  owner->dy = replRealBits(man->dy);
+  owner->flags = (man->state & CONTROL_WALKING ? REPL_WALKING : 0) |
+                 (man->state & CONTROL_SHOOTING ? REPL_SHOOTING : 0) |
+                 (man->state & CONTROL_LEFT ? REPL_TURNED : 0);
+}
+
+void showOwner(const ReplOwner *owner, Man *man) {
+  man->x = replRealFromBits(owner->x);
+  man->y = replRealFromBits(owner->y);
+  man->dx = replRealFromBits(owner->dx);
+  man->dy = replRealFromBits(owner->dy);
+  man->state = (owner->flags & REPL_WALKING ? CONTROL_WALKING : 0) |
+               (owner->flags & REPL_SHOOTING ? CONTROL_SHOOTING : 0) |
+               (owner->flags & REPL_TURNED ? CONTROL_LEFT : 0);
+}
+
+/* the prediction got the server's state exactly */
+int predicted(const Man *man, const ReplOwner *owner) {
+  ReplOwner mine;
+
+  captureOwner(man, &mine);
+  return mine.x == owner->x && mine.y == owner->y && mine.dx == owner->dx &&
+         mine.dy == owner->dy && mine.flags == owner->flags;
+}
+
+/*
+ * Checks the man predicted for the newest input the server applied against
+ * what the server made of it. On a difference the man starts over from the
+ * server's state and the inputs since are replayed; where he is drawn only
+ * eases over to the new position.
+ */
+void reconcile(Prediction *pred, const ReplClient *repl, Man *man) {
+  const ReplOwner *owner = &repl->man;
+  Uint32 behind = repl->input - owner->input;
+  float x = realToFloat(man->x), y = realToFloat(man->y);
+  float error;
+  Uint32 n;
+
+  if (!repl->owner) {
+    pred->synced = 0;
+    return;
+  }
+  if (pred->synced && repl->tick == pred->checked)
+    return;
+  pred->checked = repl->tick;
+  if (pred->synced && owner->input > 0 && behind < REPL_INPUTS) {
+    pred->checks++;
+    if (predicted(&pred->states[owner->input & (REPL_INPUTS - 1)], owner))
+      return;
+  }
+
+  showOwner(owner, man);
+  for (n = owner->input + 1; behind < REPL_INPUTS && n <= repl->input; n++) {
+    steerMan(man, repl->inputs[n & (REPL_INPUTS - 1)], NULL);
+    updateMan(man);
+    pred->states[n & (REPL_INPUTS - 1)] = *man;
+  }
+  if (!pred->synced) {
+    pred->synced = 1;
+    return;
+  }
+  x -= realToFloat(man->x);
+  y -= realToFloat(man->y);
+  pred->corrections++;
+  pred->errorX += x;
+  pred->errorY += y;
+  error = SDL_sqrtf(x * x + y * y);
+  if (error > pred->worstError)
+    pred->worstError = error;
+}
+
+/* the man a step on with the newest input, as the server will do it */
+void predict(Prediction *pred, const ReplClient *repl, Man *man) {
+  pred->errorX *= SMOOTHING;
+  pred->errorY *= SMOOTHING;
+  if (pred->errorX * pred->errorX + pred->errorY * pred->errorY < 0.01f)
+    pred->errorX = pred->errorY = 0;
+  if (!pred->synced)
+    return;
+  steerMan(man, repl->inputs[repl->input & (REPL_INPUTS - 1)], NULL);
+  updateMan(man);
+  pred->states[repl->input & (REPL_INPUTS - 1)] = *man;
+}
+
+/*
+ * --server <port> <ticks> [turrets] [budget bytes] [latency ms] [jitter ms]
+ * [loss %]: the game run headless and authoritative at the fixed tick,
+ * snapshots sent to every client. Extra turrets along the level fill the
+ * enemy pool with a few thousand bullets. It starts on the first client
+ * and prints what the simulation and the snapshots cost per tick.
+ */
+int runServer(int argc, char *argv[]) {
+  static Emitter turrets[SERVER_TURRETS_MAX];
+  BulletPool *pools[REPL_POOLS];
+  ReplActor actors[REPL_ACTORS];
+  ReplOwner owner;
+  TickInput inputs[SERVER_CATCH_UP];
+  NetConditions conditions;
+  Man man;
+  Uint64 start;
+  Uint32 nextTick, now;
+  double us, simUs = 0, worstUs = 0;
+  int port, ticks, count, budget, n, i;
+
+  if (argc < 4) {
+    printf("usage: %s %s <port> <ticks> [turrets] [budget bytes] "
+           "[latency ms] [jitter ms] [loss %%]\n",
+           argv[0], argv[1]);
+    return 1;
+  }
+  port = SDL_atoi(argv[2]);
+  ticks = SDL_atoi(argv[3]);
+  count = argc > 4 ? SDL_atoi(argv[4]) : SERVER_TURRETS;
+  count = SDL_max(0, SDL_min(count, SERVER_TURRETS_MAX));
+  budget = argc > 5 ? SDL_atoi(argv[5]) : SERVER_BUDGET;
+  conditions.latencyMs = argc > 6 ? SDL_atoi(argv[6]) : 0;
+  conditions.jitterMs = argc > 7 ? SDL_atoi(argv[7]) : 0;
+  conditions.lossPercent = argc > 8 ? SDL_atoi(argv[8]) : 0;
+
+  if (startReplay(&man) != 0)
+    return 1;
+  if (serverOpen((Uint16)port, &conditions, budget) != 0) {
+    printf("Cannot open UDP port %d\n", port);
+    tilemapClose(&level);
+    return 1;
+  }
+  for (i = 0; i < count; i++)
+    emitterStart(&turrets[i], i % PATTERN_COUNT);
+  horde.count = 0; /* not replicated, the turrets are the load */
+  particlesMute(1); /* nobody is watching */
+  pools[0] = &bullets;
+  pools[1] = &enemyBullets;
+  pools[2] = &rivalBullets;
+
+  start = SDL_GetTicks();
+  while (serverClientCount() == 0) {
+    if (SDL_GetTicks() - start > CLIENT_TIMEOUT) {
+      printf("no client turned up\n");
+      serverClose();
+      tilemapClose(&level);
+      return 1;
+    }
+    SDL_Delay(1);
+    serverPoll();
+  }
+
+  nextTick = SDL_GetTicks();
+  while (globalTime < ticks) {
+    serverPoll();
+
+    /* the man steps once per input, as the client predicted him */
+    start = SDL_GetPerformanceCounter();
+    n = serverInputs(inputs);
+    for (i = 0; i < n; i++) {
+      applyInput(&man, inputs[i]);
+      updateMan(&man);
+    }
+    for (i = 0; i < count; i++)
+      emitterUpdate(&turrets[i], &enemyBullets,
+                    realFromInt(TURRET_SPACING * (i + 1)), realFromInt(40),
+                    man.x + realFromInt(20), man.y + realFromInt(25));
+    updateWorld(&man);
+    updateCamera(&man);
+    us = (double)(SDL_GetPerformanceCounter() - start) * 1e6 /
+         (double)SDL_GetPerformanceFrequency();
+    simUs += us;
+    if (us > worstUs)
+      worstUs = us;
+
+    captureActors(&man, actors);
+    captureOwner(&man, &owner);
+    serverBroadcast((Uint32)globalTime, actors, &owner, pools);
+
+    nextTick += TICK_MS;
+    now = SDL_GetTicks();
+    if ((Sint32)(nextTick - now) > 0)
+      SDL_Delay(nextTick - now);
+  }
+
+  serverPrintStats();
+  printf("server: simulation %.1f us a tick (%.1f worst)\n",
+         simUs / (double)ticks, worstUs);
+  serverClose();
+  tilemapClose(&level);
+  return 0;
+}
+
+/*
+ * --server-clients <first port> <server port> <count> <ticks> [latency ms]
+ * [jitter ms] [loss %]: headless clients on consecutive ports, the first
+ * one playing the --replay-fire script, predicting the man and watching
+ * him, the others looking at spots along the level. The network
+ * conditions apply to what the first one sends. Each keeps its own copy of
+ * the world from the snapshots. Fails on a snapshot that does not decode,
+ * or if a client ends up with bullets in view still waiting, which packet
+ * loss on the last ticks can cause too. See 'make server-test'.
+ */
+int serverClients(int argc, char *argv[]) {
+  typedef struct {
+    NetLink link;
+    ReplClient repl;
+    BulletPool pools[REPL_POOLS];
+    int caughtUp; /* ticks until it first held every bullet */
+  } TestClient;
+  TestClient *clients;
+  NetConditions conditions;
+  Man man;
+  Uint8 data[NET_PACKET_MAX];
+  Uint32 start, nextTick, now, heard;
+  unsigned long packets = 0, bytes = 0, stale = 0, errors = 0, behind = 0;
+  int port, serverPort, count, ticks, complete = 0, caughtUp = 0;
+  int tick = 0;
+  int i, p, size, view;
+
+  if (argc < 6) {
+    printf("usage: %s %s <first port> <server port> <count> <ticks>\n",
+           argv[0], argv[1]);
+    return 1;
+  }
+  port = SDL_atoi(argv[2]);
+  serverPort = SDL_atoi(argv[3]);
+  count = SDL_max(1, SDL_min(SDL_atoi(argv[4]), SERVER_CLIENTS));
+  ticks = SDL_atoi(argv[5]);
+  conditions.latencyMs = argc > 6 ? SDL_atoi(argv[6]) : 0;
+  conditions.jitterMs = argc > 7 ? SDL_atoi(argv[7]) : 0;
+  conditions.lossPercent = argc > 8 ? SDL_atoi(argv[8]) : 0;
+
+  /* the level, for predicting the man */
+  if (startReplay(&man) != 0)
+    return 1;
+  memset(&prediction, 0, sizeof(prediction));
+  clients = (TestClient *)malloc(sizeof(TestClient) * (size_t)count);
+  if (!clients) {
+    tilemapClose(&level);
+    return 1;
+  }
+  for (i = 0; i < count; i++) {
+    BulletPool *pools[REPL_POOLS];
+    for (p = 0; p < REPL_POOLS; p++)
+      pools[p] = &clients[i].pools[p];
+    replClientStart(&clients[i].repl, pools);
+    clients[i].caughtUp = -1;
+    if (netOpen(&clients[i].link, (Uint16)(port + i), (Uint16)serverPort,
+                i == 0 ? &conditions : NULL) != 0) {
+      printf("Cannot open UDP port %d\n", port + i);
+      while (i-- > 0)
+        netClose(&clients[i].link);
+      free(clients);
+      tilemapClose(&level);
+      return 1;
+    }
+  }
+
+  start = heard = nextTick = SDL_GetTicks();
+  while ((int)clients[0].repl.tick < ticks || !clients[0].repl.started) {
+    for (i = 0; i < count; i++) {
+      TestClient *c = &clients[i];
+      TickInput input;
+
+      while ((size = netReceive(&c->link, data, sizeof(data))) >= 0) {
+        heard = SDL_GetTicks();
+        if (replClientApply(&c->repl, data, size) == 0 && c->caughtUp < 0 &&
+            replClientComplete(&c->repl))
+          c->caughtUp = (int)c->repl.packets;
+      }
+      input.held = input.pressed = 0;
+      view = (i % 16) * 100;
+      if (i == 0) {
+        reconcile(&prediction, &c->repl, &man);
+        if (!c->repl.owner)
+          showActor(&c->repl.actors[0], &man);
+        input = replayInput(tick);
+        view = viewLeft(&man);
+      }
+      if (i > 0 && !clients[0].repl.started)
+        continue; /* the first one joins first and controls the man */
+      size = replClientAck(&c->repl, input, view, data);
+      if (i == 0 && c->repl.owner)
+        predict(&prediction, &c->repl, &man);
+      netSend(&c->link, data, size);
+    }
+    tick++;
+
+    nextTick += TICK_MS;
+    now = SDL_GetTicks();
+    if (now - heard > (clients[0].repl.started ? 2000u : CLIENT_TIMEOUT)) {
+      printf("server went quiet at tick %lu\n",
+             (unsigned long)clients[0].repl.tick);
+      break;
+    }
+    if ((Sint32)(nextTick - now) > 0)
+      SDL_Delay(nextTick - now);
+  }
+
+  for (i = 0; i < count; i++) {
+    const ReplClient *r = &clients[i].repl;
+    packets += r->packets;
+    bytes += r->bytes;
+    stale += r->stale;
+    errors += r->errors;
+    behind += r->incomplete;
+    complete += replClientComplete(r);
+    if (clients[i].caughtUp > caughtUp)
+      caughtUp = clients[i].caughtUp;
+    netClose(&clients[i].link);
+  }
+  printf("clients: %d, %lu snapshots, %.1f bytes each, %lu stale, "
+         "%lu bad\n",
+         count, packets, packets ? (double)bytes / (double)packets : 0.0,
+         stale, errors);
+  printf("clients: all in view held after %d snapshots at most, some "
+         "waiting in %lu snapshots\n",
+         caughtUp, behind);
+  printf("clients: %d of %d hold all in view at the end, %lu seconds\n",
+         complete, count, (unsigned long)(SDL_GetTicks() - start) / 1000);
+  printf("prediction: %lu corrections in %lu snapshots checked (%.2f%%), "
+         "worst %.1f pixels off\n",
+         prediction.corrections, prediction.checks,
+         prediction.checks ? 100.0 * (double)prediction.corrections /
+                                 (double)prediction.checks
+                           : 0.0,
+         (double)prediction.worstError);
+  free(clients);
+  tilemapClose(&level);
+  return errors > 0 || complete < count;
+}
+
+/*
+ * --connect <port> <server port>: plays on a --server. The world is drawn
+ * from the latest snapshot, local input goes out with every
+ * acknowledgement.
+ */
+int startClient(int argc, char *argv[]) {
+  BulletPool *pools[REPL_POOLS];
+  int port, server;
+
+  if (argc < 4) {
+    printf("usage: %s %s <port> <server port>\n", argv[0], argv[1]);
+    return -1;
+  }
+  port = SDL_atoi(argv[2]);
+  server = SDL_atoi(argv[3]);
+  if (netOpen(&netLink, (Uint16)port, (Uint16)server, NULL) != 0) {
+    printf("Cannot open UDP port %d\n", port);
+    return -1;
+  }
+  pools[0] = &bullets;
+  pools[1] = &enemyBullets;
+  pools[2] = &rivalBullets;
+  replClientStart(&remote, pools);
+  remotePlay = 1;
+  horde.count = 0; /* the server has none */
+  return 0;
+}
+
+void clientTick(Man *man, TickInput input) {
+  Uint8 data[NET_PACKET_MAX];
+  int size;
+
+  while ((size = netReceive(&netLink, data, sizeof(data))) >= 0)
+    replClientApply(&remote, data, size);
+  reconcile(&prediction, &remote, man);
+  if (!remote.owner)
+    showActor(&remote.actors[0], man); /* someone else controls him */
+  size = replClientAck(&remote, input, (int)cameraX, data);
+  if (remote.owner)
+    predict(&prediction, &remote, man);
+  netSend(&netLink, data, size);
+
+  showActor(&remote.actors[1], &enemy);
+  showActor(&remote.actors[2], &rival);
+  globalTime = (int)remote.tick;
+}
+
+int main(int argc, char *argv[]) {
   Man man;
   SDL_Window *window;     /* Declare a window */
   SDL_Renderer *renderer; /* Declare a renderer */
-  SDL_Surface *sheet;
-  SDL_Surface *bg;
-  SDL_Surface *bullet;
+  Uint32 nextTick;
   int done;
-  int i;
+  int replay = argc > 1 && strcmp(argv[1], "--replay-fire") == 0;
+  int versus = argc > 1 && strcmp(argv[1], "--versus") == 0;
+  int connectServer = argc > 1 && strcmp(argv[1], "--connect") == 0;
+  int replayFailures = 0;
+  int status = 0;
+
+  if (argc > 1 && strcmp(argv[1], "--bench-tilemap") == 0)
+    return benchTilemap();
+  if (argc > 1 && strcmp(argv[1], "--bench-collision") == 0)
+    return benchCollision();
+  if (argc > 1 && strcmp(argv[1], "--bench-bullets") == 0)
+    return benchBullets();
+  if (argc > 1 && strcmp(argv[1], "--bench-ring") == 0)
+    return benchRing();
+  if (argc > 1 && strcmp(argv[1], "--bench-audio") == 0)
+    return benchAudio();
+  if (argc > 1 && strcmp(argv[1], "--bench-sounds") == 0)
+    return benchSounds();
+  if (argc > 1 && strcmp(argv[1], "--bench-ai") == 0)
+    return benchAi();
+  if (argc > 1 && strcmp(argv[1], "--bench-flow") == 0)
+    return benchFlow();
+  if (argc > 1 && strcmp(argv[1], "--bench-control") == 0)
+    return benchControl();
+  if (argc > 1 && strcmp(argv[1], "--replay-checksum") == 0)
+    return replayChecksum();
+  if (argc > 1 && strcmp(argv[1], "--bench-snapshot") == 0)
+    return benchSnapshot();
+  if (argc > 1 && strcmp(argv[1], "--versus-bot") == 0)
+    return versusBot(argc, argv);
+  if (argc > 1 && strcmp(argv[1], "--server") == 0)
+    return runServer(argc, argv);
+  if (argc > 1 && strcmp(argv[1], "--server-clients") == 0)
+    return serverClients(argc, argv);
+
+  /* before SDL_Init so every SDL allocation is accounted for */
+  memtrackInit();
+
+  if (replay && !memtrackEnabled()) {
+    printf("--replay-fire needs heap tracking, build with TARGET=DEVEL\n");
+    return 1;
+  }
 
-  SDL_Init(SDL_INIT_VIDEO); /* Initialize SDL2 */
+  if (frameArenaInit(FRAME_ARENA_SIZE) != 0) {
+    printf("Cannot allocate frame arenas\n");
+    return 1;
+  }
 
-  man.x = 50;
-  man.y = 0;
-  man.currentSprite = 4;
-  man.alive = 1;
-  man.visible = 1;
-  man.facingLeft = 0;
+  SDL_Init(SDL_INIT_VIDEO); /* Initialize SDL2 */
 
-  enemy.x = 250;
-  enemy.y = 60;
-  enemy.currentSprite = 4;
-  enemy.facingLeft = 1;
-  enemy.alive = 1;
-  enemy.visible = 1;
+  initActors(&man);
 
   /* Create an application window with the following settings: */
   window = SDL_CreateWindow("Game Window",           /* window title */
@@ -284,84 +1389,212 @@ int main(void) {
                             SDL_WINDOWPOS_UNDEFINED, /* initial y position */
                             640,                     /* width, in pixels */
                             480,                     /* height, in pixels */
-                            0                        /* flags */
+                            replay ? SDL_WINDOW_HIDDEN : 0 /* flags */
   );
-  renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+  /* the replay runs headless too, under SDL_VIDEODRIVER=dummy */
+  renderer = SDL_CreateRenderer(
+      window, -1, replay ? SDL_RENDERER_SOFTWARE : SDL_RENDERER_ACCELERATED);
 
   SDL_RenderSetLogicalSize(renderer, 320, 240);
+  parallaxInit(renderer, SCREEN_W, SCREEN_H);
+
+  openAssets();
+  texCacheInit(&textures, renderer, TEXTURE_BUDGET);
+  texCacheUsePack(&textures, &assets);
 
-  sheet = IMG_Load("sheet.png");
-  if (!sheet) {
+  man.sheetTexture = texCacheAcquire(&textures, "sheet.png");
+  if (man.sheetTexture < 0) {
     printf("Cannot find sheet\n");
     puts(IMG_GetError());
     return 1;
   }
 
-  man.sheetTexture = SDL_CreateTextureFromSurface(renderer, sheet);
-  SDL_FreeSurface(sheet);
-
   /* load enemy */
-  sheet = IMG_Load("badman_sheet.png");
-  if (!sheet) {
+  enemy.sheetTexture = texCacheAcquire(&textures, "badman_sheet.png");
+  if (enemy.sheetTexture < 0) {
     printf("Cannot find enemy sheet\n");
     return 1;
   }
 
-  enemy.sheetTexture = SDL_CreateTextureFromSurface(renderer, sheet);
-  SDL_FreeSurface(sheet);
-
   /* load the bg */
-  bg = IMG_Load("background.png");
-
-  if (!sheet) {
+  backgroundTexture = texCacheAcquire(&textures, "background.png");
+  if (backgroundTexture < 0) {
     printf("Cannot find background\n");
     return 1;
   }
 
-  backgroundTexture = SDL_CreateTextureFromSurface(renderer, bg);
-  SDL_FreeSurface(bg);
-
   /* load the bullet */
-  bullet = IMG_Load("bullet.png");
-
-  if (!bullet) {
+  bulletTexture = texCacheAcquire(&textures, "bullet.png");
+  if (bulletTexture < 0) {
     printf("Cannot find bullet\n");
     return 1;
   }
 
-  bulletTexture = SDL_CreateTextureFromSurface(renderer, bullet);
-  SDL_FreeSurface(bullet);
+  if (openLevel("level1.lvl") != 0) {
+    printf("Cannot find level1.lvl\n");
+    return 1;
+  }
+  updateCamera(&man);
+  moveMan(&enemy, 0, realFromInt(SCREEN_H)); /* drop onto the ground */
+  spawnHorde();
+
+  patternsInit();
+
+  if (versus && startVersus(&man, argc, argv) != 0)
+    return 1;
+  if (connectServer && startClient(argc, argv) != 0)
+    return 1;
+
+  /* pick up edited sprite sheets without a restart */
+  if (!replay)
+    assetWatchStart(".");
+
+  /* the game plays on silent without its sounds or a sound device */
+  if (!replay) {
+    if (openSounds() != 0)
+      printf("Cannot find sounds.pak\n");
+    audioUsePack(&sounds);
+    if (audioOpen() != 0)
+      printf("Playing without sound\n");
+  }
 
   /* The window is open: enter program loop (see SDL_PollEvent) */
   done = 0;
+  inputStart();
+  nextTick = SDL_GetTicks();
 
   /* Event loop */
   while (!done) {
-    /* Check for events */
+    Uint32 now;
+    int ticks;
+
+    /* Swap in reloaded assets between frames */
+    assetWatchPump(&textures);
+
+    /* From here on the frame runs on preallocated memory only */
+    memtrackSetPhase(MEM_PHASE_EVENTS);
+
+    /* Check for events, this also feeds the input queue */
     done = processEvents(window, &man);
 
-    /* Update logic */
-    updateLogic(&man);
+    memtrackSetPhase(MEM_PHASE_UPDATE);
+    if (replay) {
+      /* one scripted tick per frame, as fast as we can render */
+      applyInput(&man, replayInput(globalTime));
+      updateLogic(&man);
+      if (globalTime >= REPLAY_TICKS)
+        done = 1;
+    } else {
+      /* Update logic at a fixed rate, whatever the frame rate is */
+      now = SDL_GetTicks();
+      for (ticks = 0; (Sint32)(now - nextTick) >= 0; ticks++) {
+        if (ticks == MAX_CATCH_UP) {
+          nextTick = now;
+          break;
+        }
+        nextTick += TICK_MS;
+        if (versusSide >= 0) {
+          rollbackTick(&netplay, inputTick(nextTick));
+          continue;
+        }
+        if (remotePlay) {
+          clientTick(&man, inputTick(nextTick));
+          continue;
+        }
+        applyInput(&man, inputTick(nextTick));
+        updateLogic(&man);
+      }
+    }
+
+    /* Scroll and stream in the chunks coming into view */
+    updateCamera(versusSide == 1 ? &rival : &man);
 
     /* Render display */
+    memtrackSetPhase(MEM_PHASE_RENDER);
     doRender(renderer, &man);
 
-    /* don't burn up the CPU */
-    SDL_Delay(10);
+    frameArenaEndFrame();
+    memtrackEndFrame();
+
+    if (replay && globalTime > MEMTRACK_WARMUP_FRAMES &&
+        memtrackFrameAllocs() > 0 && replayFailures++ == 0)
+      printf("tick %d allocated: %lu events, %lu update, %lu render\n",
+             globalTime, memtrackFramePhase(MEM_PHASE_EVENTS)->allocs,
+             memtrackFramePhase(MEM_PHASE_UPDATE)->allocs,
+             memtrackFramePhase(MEM_PHASE_RENDER)->allocs);
+
+    if (showOverlay && globalTime % 100 == 0)
+      latencyShowInTitle(window);
+
+    if (replay)
+      continue;
+
+    /* don't burn up the CPU, sleep until the next tick is due */
+    now = SDL_GetTicks();
+    if ((Sint32)(nextTick - now) > 0)
+      SDL_Delay(nextTick - now);
+  }
+
+  inputStop();
+  assetWatchStop();
+  audioClose();
+  latencyPrint();
+  if (inputDropped() > 0)
+    printf("input: %lu key edges dropped on a full queue\n", inputDropped());
+#ifndef NDEBUG
+  audioPrintStats();
+  aiPrintStats();
+  flowPrintStats();
+#endif
+  if (versusSide >= 0) {
+    rollbackPrintStats(&netplay);
+    netClose(&netLink);
+  }
+  if (remotePlay) {
+    printf("client: %lu snapshots, %.1f bytes each, %lu stale, %lu bad\n",
+           remote.packets,
+           remote.packets ? (double)remote.bytes / (double)remote.packets
+                          : 0.0,
+           remote.stale, remote.errors);
+    printf("client: %lu predictions corrected of %lu checked, worst %.1f "
+           "pixels off\n",
+           prediction.corrections, prediction.checks,
+           (double)prediction.worstError);
+    netClose(&netLink);
   }
+  texCacheRelease(&textures, man.sheetTexture);
+  texCacheRelease(&textures, backgroundTexture);
+  texCacheRelease(&textures, bulletTexture);
+  texCacheRelease(&textures, enemy.sheetTexture);
+#ifndef NDEBUG
+  texCachePrintStats(&textures);
+#endif
+  texCacheDestroy(&textures);
+  parallaxShutdown();
+  assetPackClose(&assets);
+  soundPackClose(&sounds);
+  tilemapClose(&level);
 
   /* Close and destroy the window */
-  SDL_DestroyWindow(window);
   SDL_DestroyRenderer(renderer);
-  SDL_DestroyTexture(man.sheetTexture);
-  SDL_DestroyTexture(backgroundTexture);
-  SDL_DestroyTexture(bulletTexture);
-  SDL_DestroyTexture(enemy.sheetTexture);
+  SDL_DestroyWindow(window);
 
-  for (i = 0; i < MAX_BULLETS; i++)
-    removeBullet(i);
+#ifndef NDEBUG
+  printf("frame arena: %lu of %lu KiB high water\n",
+         (unsigned long)(frameArenaHighWater() / 1024),
+         (unsigned long)(FRAME_ARENA_SIZE / 1024));
+  memtrackPrint();
+  printf("parallax: %lu cache columns drawn\n", parallaxColumnsDrawn());
+#endif
+  frameArenaShutdown();
+
+  if (replay) {
+    printf("replay: %d of %d steady-state frames allocated\n", replayFailures,
+           REPLAY_TICKS - MEMTRACK_WARMUP_FRAMES);
+    status = replayFailures > 0;
+  }
 
   /* Clean up */
   SDL_Quit();
-  return 0;
+  return status;
 }
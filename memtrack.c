@@ -0,0 +1,174 @@
+#include "memtrack.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *phaseNames[MEM_PHASES] = {"outside", "events", "update",
+                                             "render"};
+
+#ifdef MEMTRACK
+
+static SDL_malloc_func sdlMalloc;
+static SDL_calloc_func sdlCalloc;
+static SDL_realloc_func sdlRealloc;
+static SDL_free_func sdlFree;
+static SDL_threadID mainThread;
+static int phase;
+static unsigned long frames;
+static MemPhaseStats frame[MEM_PHASES];
+static MemPhaseStats lastFrame[MEM_PHASES];
+static MemPhaseStats total[MEM_PHASES];
+static SDL_atomic_t otherThreadAllocs;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *mem, size_t size);
+void __real_free(void *mem);
+void *__wrap_malloc(size_t size);
+void *__wrap_calloc(size_t nmemb, size_t size);
+void *__wrap_realloc(void *mem, size_t size);
+void __wrap_free(void *mem);
+#ifdef __cplusplus
+}
+#endif
+
+static void countAlloc(size_t bytes);
+static void countFree(void *mem);
+static void *trackedSdlMalloc(size_t size);
+static void *trackedSdlCalloc(size_t nmemb, size_t size);
+static void *trackedSdlRealloc(void *mem, size_t size);
+static void trackedSdlFree(void *mem);
+
+static void countAlloc(size_t bytes) {
+  if (SDL_ThreadID() != mainThread) {
+    SDL_AtomicAdd(&otherThreadAllocs, 1);
+    return;
+  }
+
+  frame[phase].allocs++;
+  frame[phase].bytes += (unsigned long)bytes;
+
+#ifdef FRAME_HEAP_ASSERT
+  if (phase != MEM_PHASE_NONE && frames >= MEMTRACK_WARMUP_FRAMES) {
+    printf("heap allocation in %s phase of frame %lu\n", phaseNames[phase],
+           frames);
+    SDL_assert(!"heap allocation inside the frame loop");
+  }
+#endif
+}
+
+static void countFree(void *mem) {
+  if (mem && SDL_ThreadID() == mainThread)
+    frame[phase].frees++;
+}
+
+/* our own code, redirected here by the linker */
+void *__wrap_malloc(size_t size) {
+  countAlloc(size);
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size) {
+  countAlloc(nmemb * size);
+  return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *mem, size_t size) {
+  countAlloc(size);
+  return __real_realloc(mem, size);
+}
+
+void __wrap_free(void *mem) {
+  countFree(mem);
+  __real_free(mem);
+}
+
+/* everything SDL and SDL_image allocate internally */
+static void *trackedSdlMalloc(size_t size) {
+  countAlloc(size);
+  return sdlMalloc(size);
+}
+
+static void *trackedSdlCalloc(size_t nmemb, size_t size) {
+  countAlloc(nmemb * size);
+  return sdlCalloc(nmemb, size);
+}
+
+static void *trackedSdlRealloc(void *mem, size_t size) {
+  countAlloc(size);
+  return sdlRealloc(mem, size);
+}
+
+static void trackedSdlFree(void *mem) {
+  countFree(mem);
+  sdlFree(mem);
+}
+
+void memtrackInit(void) {
+  mainThread = SDL_ThreadID();
+  phase = MEM_PHASE_NONE;
+  SDL_GetMemoryFunctions(&sdlMalloc, &sdlCalloc, &sdlRealloc, &sdlFree);
+  SDL_SetMemoryFunctions(trackedSdlMalloc, trackedSdlCalloc,
+                         trackedSdlRealloc, trackedSdlFree);
+}
+
+int memtrackEnabled(void) { return 1; }
+
+void memtrackSetPhase(int newPhase) { phase = newPhase; }
+
+void memtrackEndFrame(void) {
+  int i;
+
+  for (i = 0; i < MEM_PHASES; i++) {
+    total[i].allocs += frame[i].allocs;
+    total[i].frees += frame[i].frees;
+    total[i].bytes += frame[i].bytes;
+  }
+  memcpy(lastFrame, frame, sizeof(frame));
+  memset(frame, 0, sizeof(frame));
+  phase = MEM_PHASE_NONE;
+  frames++;
+}
+
+unsigned long memtrackFrameAllocs(void) {
+  return lastFrame[MEM_PHASE_EVENTS].allocs +
+         lastFrame[MEM_PHASE_UPDATE].allocs +
+         lastFrame[MEM_PHASE_RENDER].allocs;
+}
+
+const MemPhaseStats *memtrackFramePhase(int which) {
+  return &lastFrame[which];
+}
+
+void memtrackPrint(void) {
+  int i;
+
+  printf("heap over %lu frames:\n", frames);
+  for (i = 0; i < MEM_PHASES; i++)
+    printf("  %-8s %8lu allocs %8lu frees %10lu bytes\n", phaseNames[i],
+           total[i].allocs, total[i].frees, total[i].bytes);
+  printf("  other threads: %d allocs\n", SDL_AtomicGet(&otherThreadAllocs));
+}
+
+#else
+
+void memtrackInit(void) {}
+int memtrackEnabled(void) { return 0; }
+void memtrackSetPhase(int newPhase) { (void)newPhase; }
+void memtrackEndFrame(void) {}
+unsigned long memtrackFrameAllocs(void) { return 0; }
+
+const MemPhaseStats *memtrackFramePhase(int which) {
+  static const MemPhaseStats none = {0, 0, 0};
+  (void)which;
+  return &none;
+}
+
+void memtrackPrint(void) {
+  (void)phaseNames;
+  printf("heap tracking is not compiled in (build with -DMEMTRACK)\n");
+}
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef MEMTRACK_H
+#define MEMTRACK_H
+
+#include <SDL2/SDL.h>
+
+/*
+ * Heap accounting per frame phase, compiled in with -DMEMTRACK (DEVEL).
+ * Our own objects are linked with -Wl,--wrap for malloc, calloc, realloc
+ * and free, and SDL's allocator is replaced through SDL_SetMemoryFunctions,
+ * so every allocation made on the main thread is attributed to the phase
+ * the main loop is in. Other threads are only counted in bulk.
+ *
+ * With -DFRAME_HEAP_ASSERT any main-thread allocation inside a frame, once
+ * the warm-up frames are over, is an assertion failure.
+ *
+ * Without MEMTRACK every call here is a no-op.
+ */
+
+#define MEM_PHASE_NONE 0 /* outside the frame loop */
+#define MEM_PHASE_EVENTS 1
+#define MEM_PHASE_UPDATE 2
+#define MEM_PHASE_RENDER 3
+#define MEM_PHASES 4
+
+#define MEMTRACK_WARMUP_FRAMES 60
+
+typedef struct {
+  unsigned long allocs;
+  unsigned long frees;
+  unsigned long bytes;
+} MemPhaseStats;
+
+/* must run before SDL_Init() */
+void memtrackInit(void);
+int memtrackEnabled(void);
+void memtrackSetPhase(int phase);
+
+/* closes the frame: moves its counters to the totals, back to NONE */
+void memtrackEndFrame(void);
+
+/* allocations of the frame memtrackEndFrame() just closed, or of a phase */
+unsigned long memtrackFrameAllocs(void);
+const MemPhaseStats *memtrackFramePhase(int phase);
+
+void memtrackPrint(void);
+
+#endif
@@ -0,0 +1,186 @@
+#include "net.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+static Uint32 nextRandom(NetLink *link);
+#ifdef __linux__
+static int openQueue(NetLink *link);
+#endif
+static void sendNow(NetLink *link, Uint16 port, const void *data, int size);
+static void flushDue(NetLink *link);
+
+static Uint32 nextRandom(NetLink *link) {
+  link->seed = link->seed * 1664525u + 1013904223u;
+  return link->seed >> 8;
+}
+
+#ifdef __linux__
+
+/* the simulated network's queue, only when packets are held back */
+static int openQueue(NetLink *link) {
+  const NetConditions *c = &link->conditions;
+
+  if (c->latencyMs <= 0 && c->jitterMs <= 0)
+    return 0;
+  link->queue = (NetPacket *)malloc(sizeof(NetPacket) * NET_QUEUE_MAX);
+  return link->queue ? 0 : -1;
+}
+
+int netOpen(NetLink *link, Uint16 localPort, Uint16 remotePort,
+            const NetConditions *conditions) {
+  struct sockaddr_in addr;
+
+  memset(link, 0, sizeof(*link));
+  link->socket = -1;
+  link->remotePort = remotePort;
+  link->seed = (Uint32)localPort * 2654435761u;
+  if (conditions)
+    link->conditions = *conditions;
+
+  link->socket = socket(AF_INET, SOCK_DGRAM, 0);
+  if (link->socket < 0)
+    return -1;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(localPort);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(link->socket, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      fcntl(link->socket, F_SETFL, O_NONBLOCK) != 0 || openQueue(link) != 0) {
+    netClose(link);
+    return -1;
+  }
+  return 0;
+}
+
+void netClose(NetLink *link) {
+  if (link->socket >= 0)
+    close(link->socket);
+  link->socket = -1;
+  free(link->queue);
+  link->queue = NULL;
+  link->queued = 0;
+}
+
+static void sendNow(NetLink *link, Uint16 port, const void *data, int size) {
+  struct sockaddr_in addr;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (sendto(link->socket, data, (size_t)size, 0, (struct sockaddr *)&addr,
+             sizeof(addr)) == size)
+    link->sent++;
+}
+
+int netReceiveFrom(NetLink *link, void *data, int capacity, Uint16 *port) {
+  struct sockaddr_in addr;
+  socklen_t length = sizeof(addr);
+  ssize_t size;
+
+  flushDue(link);
+  size = recvfrom(link->socket, data, (size_t)capacity, 0,
+                  (struct sockaddr *)&addr, &length);
+  if (size < 0)
+    return -1;
+  if (port)
+    *port = ntohs(addr.sin_port);
+  link->received++;
+  return (int)size;
+}
+
+#else
+
+int netOpen(NetLink *link, Uint16 localPort, Uint16 remotePort,
+            const NetConditions *conditions) {
+  memset(link, 0, sizeof(*link));
+  link->socket = -1;
+  (void)localPort;
+  (void)remotePort;
+  (void)conditions;
+  return -1;
+}
+
+void netClose(NetLink *link) {
+  free(link->queue);
+  link->queue = NULL;
+  link->queued = 0;
+}
+
+static void sendNow(NetLink *link, Uint16 port, const void *data, int size) {
+  (void)link;
+  (void)port;
+  (void)data;
+  (void)size;
+}
+
+int netReceiveFrom(NetLink *link, void *data, int capacity, Uint16 *port) {
+  (void)link;
+  (void)data;
+  (void)capacity;
+  (void)port;
+  return -1;
+}
+
+#endif
+
+/* packets whose simulated transit is over go out */
+static void flushDue(NetLink *link) {
+  Uint32 now = SDL_GetTicks();
+  int i = 0;
+
+  while (i < link->queued) {
+    NetPacket *packet = &link->queue[i];
+    if ((Sint32)(now - packet->due) < 0) {
+      i++;
+      continue;
+    }
+    sendNow(link, packet->port, packet->data, packet->size);
+    *packet = link->queue[--link->queued];
+  }
+}
+
+int netReceive(NetLink *link, void *data, int capacity) {
+  return netReceiveFrom(link, data, capacity, NULL);
+}
+
+void netSend(NetLink *link, const void *data, int size) {
+  netSendTo(link, link->remotePort, data, size);
+}
+
+void netSendTo(NetLink *link, Uint16 port, const void *data, int size) {
+  const NetConditions *c = &link->conditions;
+  NetPacket *packet;
+
+  if (size > NET_PACKET_MAX)
+    return;
+  if (c->lossPercent > 0 && (int)(nextRandom(link) % 100) < c->lossPercent) {
+    link->dropped++;
+    return;
+  }
+  if (!link->queue) {
+    sendNow(link, port, data, size);
+    return;
+  }
+  if (link->queued == NET_QUEUE_MAX) {
+    link->dropped++;
+    return;
+  }
+
+  packet = &link->queue[link->queued++];
+  packet->due = SDL_GetTicks() + (Uint32)c->latencyMs;
+  if (c->jitterMs > 0)
+    packet->due += nextRandom(link) % (Uint32)(c->jitterMs + 1);
+  packet->port = port;
+  packet->size = size;
+  memcpy(packet->data, data, (size_t)size);
+}
@@ -0,0 +1,53 @@
+#ifndef NET_H
+#define NET_H
+
+#include <SDL2/SDL.h>
+
+/*
+ * Unreliable datagrams between ports on the local machine, non-blocking.
+ * A link has one default peer; a server answers many through
+ * netSendTo()/netReceiveFrom(). Outgoing packets can be put through
+ * simulated network conditions: held back by a latency plus a random
+ * jitter (which also reorders them) and dropped at a given rate, all
+ * decided on the sending side. Without BSD sockets (anything but Linux for
+ * now) netOpen() fails.
+ */
+
+#define NET_PACKET_MAX 1400 /* fits an Ethernet MTU with the headers */
+#define NET_QUEUE_MAX 1024  /* packets in flight through the simulation */
+
+typedef struct {
+  int latencyMs; /* one way */
+  int jitterMs;  /* up to this much extra, per packet */
+  int lossPercent;
+} NetConditions;
+
+typedef struct {
+  Uint32 due; /* SDL_GetTicks() time it leaves */
+  Uint16 port;
+  int size;
+  Uint8 data[NET_PACKET_MAX];
+} NetPacket;
+
+typedef struct {
+  int socket;
+  Uint16 remotePort;
+  NetConditions conditions;
+  Uint32 seed;
+  NetPacket *queue; /* NET_QUEUE_MAX, only with latency or jitter */
+  int queued;
+  unsigned long sent, dropped, received;
+} NetLink;
+
+int netOpen(NetLink *link, Uint16 localPort, Uint16 remotePort,
+            const NetConditions *conditions);
+void netClose(NetLink *link);
+
+void netSend(NetLink *link, const void *data, int size);
+void netSendTo(NetLink *link, Uint16 port, const void *data, int size);
+
+/* sends what is due, then returns the next packet's size or -1 for none */
+int netReceive(NetLink *link, void *data, int capacity);
+int netReceiveFrom(NetLink *link, void *data, int capacity, Uint16 *port);
+
+#endif
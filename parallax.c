@@ -0,0 +1,232 @@
+#include "parallax.h"
+#include "arena.h"
+#include <string.h>
+
+typedef struct {
+  float rate;      /* of the camera's scroll speed */
+  int top, bottom; /* screen band the layer can cover */
+  int period;      /* pixels between outline knots */
+  Uint32 seed;
+  Uint8 r, g, b;
+} ParallaxLayer;
+
+typedef struct {
+  float rate;
+  int top, bottom;
+  SDL_Texture *texture;
+  int validStart; /* first layer column held, -1 when nothing is */
+} ParallaxCache;
+
+/* far to near, layers sharing a rate end up in the same cache */
+static const ParallaxLayer layers[] = {
+    {0.25f, 60, 160, 64, 11, 70, 90, 140}, /* mountains */
+    {0.5f, 100, 180, 48, 23, 50, 110, 80}, /* hills */
+    {0.5f, 140, 180, 12, 37, 35, 85, 60},  /* bushes on the hills */
+};
+
+#define LAYER_COUNT (int)(sizeof(layers) / sizeof(layers[0]))
+
+static ParallaxCache caches[PARALLAX_MAX_CACHES];
+static int cacheCount;
+static int width;
+static int direct; /* no render targets, the layers are drawn every frame */
+static unsigned long columnsDrawn;
+
+static Uint32 knotHeight(Uint32 knot, Uint32 seed, int range);
+static int outline(const ParallaxLayer *layer, int u);
+static void drawColumns(SDL_Renderer *renderer, const ParallaxCache *cache,
+                        int u0, int u1, int scroll);
+static void updateCache(SDL_Renderer *renderer, ParallaxCache *cache,
+                        int scroll);
+
+static Uint32 knotHeight(Uint32 knot, Uint32 seed, int range) {
+  Uint32 h = knot * 2654435761u ^ seed;
+  h ^= h >> 15;
+  h *= 2246822519u;
+  h ^= h >> 13;
+  return h % (Uint32)range;
+}
+
+/* top of the layer's silhouette at layer column u, in screen rows */
+static int outline(const ParallaxLayer *layer, int u) {
+  int range = (layer->bottom - layer->top) * 3 / 4;
+  Uint32 knot = (Uint32)(u / layer->period);
+  int t = u % layer->period;
+  int h0 = (int)knotHeight(knot, layer->seed, range);
+  int h1 = (int)knotHeight(knot + 1, layer->seed, range);
+
+  return layer->top + h0 + (h1 - h0) * t / layer->period;
+}
+
+/*
+ * Draws layer columns [u0, u1) of every layer in the cache: into the cache
+ * ring, or with scroll >= 0 straight to the screen at u - scroll.
+ */
+static void drawColumns(SDL_Renderer *renderer, const ParallaxCache *cache,
+                        int u0, int u1, int scroll) {
+  int n = u1 - u0;
+  int yOffset = scroll < 0 ? cache->top : 0;
+  int i, u;
+
+  for (i = 0; i < LAYER_COUNT; i++) {
+    const ParallaxLayer *layer = &layers[i];
+    SDL_Rect *rects;
+
+    if (layer->rate != cache->rate)
+      continue;
+    rects = (SDL_Rect *)frameAlloc(sizeof(SDL_Rect) * (size_t)n);
+    if (!rects)
+      return;
+
+    for (u = u0; u < u1; u++) {
+      SDL_Rect *rect = &rects[u - u0];
+      int y = outline(layer, u);
+      rect->x = scroll < 0 ? u % width : u - scroll;
+      rect->y = y - yOffset;
+      rect->w = 1;
+      rect->h = layer->bottom - y;
+    }
+    SDL_SetRenderDrawColor(renderer, layer->r, layer->g, layer->b, 255);
+    SDL_RenderFillRects(renderer, rects, n);
+  }
+  columnsDrawn += (unsigned long)n;
+}
+
+/* brings the ring up to date for the view starting at layer column scroll */
+static void updateCache(SDL_Renderer *renderer, ParallaxCache *cache,
+                        int scroll) {
+  SDL_Rect clear[2];
+  int clears = 1;
+  int u0, u1;
+
+  if (cache->validStart < 0 || SDL_abs(scroll - cache->validStart) >= width) {
+    u0 = scroll;
+    u1 = scroll + width;
+  } else if (scroll > cache->validStart) {
+    u0 = cache->validStart + width;
+    u1 = scroll + width;
+  } else if (scroll < cache->validStart) {
+    u0 = scroll;
+    u1 = cache->validStart;
+  } else {
+    return;
+  }
+
+  /* the strip may wrap around the end of the ring */
+  clear[0].x = u0 % width;
+  clear[0].y = 0;
+  clear[0].w = SDL_min(u1 - u0, width - clear[0].x);
+  clear[0].h = cache->bottom - cache->top;
+  if (clear[0].w < u1 - u0) {
+    clear[1] = clear[0];
+    clear[1].x = 0;
+    clear[1].w = u1 - u0 - clear[0].w;
+    clears = 2;
+  }
+
+  SDL_SetRenderTarget(renderer, cache->texture);
+  SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+  SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+  SDL_RenderFillRects(renderer, clear, clears);
+  drawColumns(renderer, cache, u0, u1, -1);
+  SDL_SetRenderTarget(renderer, NULL);
+
+  cache->validStart = scroll;
+}
+
+int parallaxInit(SDL_Renderer *renderer, int viewW, int viewH) {
+  int i, j;
+
+  memset(caches, 0, sizeof(caches));
+  cacheCount = 0;
+  width = viewW;
+  direct = !SDL_RenderTargetSupported(renderer);
+
+  /* one cache per distinct rate, covering the union of its layers' bands */
+  for (i = 0; i < LAYER_COUNT; i++) {
+    ParallaxCache *cache = NULL;
+
+    for (j = 0; j < cacheCount; j++)
+      if (caches[j].rate == layers[i].rate)
+        cache = &caches[j];
+
+    if (!cache) {
+      if (cacheCount == PARALLAX_MAX_CACHES)
+        return -1;
+      cache = &caches[cacheCount++];
+      cache->rate = layers[i].rate;
+      cache->top = layers[i].top;
+      cache->bottom = layers[i].bottom;
+      cache->validStart = -1;
+    }
+    cache->top = SDL_max(SDL_min(cache->top, layers[i].top), 0);
+    cache->bottom = SDL_min(SDL_max(cache->bottom, layers[i].bottom), viewH);
+  }
+
+  for (i = 0; i < cacheCount && !direct; i++) {
+    caches[i].texture = SDL_CreateTexture(
+        renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, width,
+        caches[i].bottom - caches[i].top);
+    if (!caches[i].texture)
+      direct = 1;
+    else
+      SDL_SetTextureBlendMode(caches[i].texture, SDL_BLENDMODE_BLEND);
+  }
+  return 0;
+}
+
+void parallaxShutdown(void) {
+  int i;
+
+  for (i = 0; i < cacheCount; i++)
+    if (caches[i].texture)
+      SDL_DestroyTexture(caches[i].texture);
+  memset(caches, 0, sizeof(caches));
+  cacheCount = 0;
+}
+
+void parallaxInvalidate(void) {
+  int i;
+  for (i = 0; i < cacheCount; i++)
+    caches[i].validStart = -1;
+}
+
+void parallaxDraw(SDL_Renderer *renderer, float cameraX) {
+  int i;
+
+  for (i = 0; i < cacheCount; i++) {
+    ParallaxCache *cache = &caches[i];
+    int scroll = (int)(cameraX * cache->rate);
+    int start = scroll % width;
+    int h = cache->bottom - cache->top;
+    SDL_Rect src, dst;
+
+    if (direct) {
+      drawColumns(renderer, cache, scroll, scroll + width, scroll);
+      continue;
+    }
+
+    updateCache(renderer, cache, scroll);
+
+    /* the ring from its seam to the end, then the start after it */
+    src.x = start;
+    src.y = 0;
+    src.w = width - start;
+    src.h = h;
+    dst.x = 0;
+    dst.y = cache->top;
+    dst.w = src.w;
+    dst.h = h;
+    SDL_RenderCopy(renderer, cache->texture, &src, &dst);
+
+    if (start > 0) {
+      src.x = 0;
+      src.w = start;
+      dst.x = width - start;
+      dst.w = start;
+      SDL_RenderCopy(renderer, cache->texture, &src, &dst);
+    }
+  }
+}
+
+unsigned long parallaxColumnsDrawn(void) { return columnsDrawn; }
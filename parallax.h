@@ -0,0 +1,28 @@
+#ifndef PARALLAX_H
+#define PARALLAX_H
+
+#include <SDL2/SDL.h>
+
+/*
+ * Parallax background. Layers scrolling at the same rate are composited
+ * into one cache texture the size of their band of the screen, used as a
+ * ring: column u of the layers lives at column u % width. When the camera
+ * moves only the newly exposed strip is drawn into the cache, and the
+ * screen gets one (split) copy of each band, so the fill cost stays close
+ * to a single full-screen quad however many layers there are.
+ */
+
+#define PARALLAX_MAX_CACHES 4
+
+int parallaxInit(SDL_Renderer *renderer, int viewW, int viewH);
+void parallaxShutdown(void);
+
+/* the caches are redrawn in full, e.g. after SDL_RENDER_TARGETS_RESET */
+void parallaxInvalidate(void);
+
+void parallaxDraw(SDL_Renderer *renderer, float cameraX);
+
+/* cache columns drawn since start up */
+unsigned long parallaxColumnsDrawn(void);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include <SDL2/SDL.h>
+
+/*
+ * Cosmetic particles. State is kept as parallel arrays (structure of
+ * arrays) so the per-tick integration is a few straight loops over floats
+ * the compiler can vectorize. Every kind has a cap on live particles; an
+ * emitter over its cap spawns fewer, so effects can't blow the frame. The
+ * cap is per kind rather than per call site: the few places that emit one
+ * kind share its budget, and a wave of debris can't starve muzzle flashes.
+ *
+ * Particles are not part of the simulation state and never feed back
+ * into it.
+ */
+
+#define PARTICLE_MAX 8192
+#define PARTICLE_ALPHA_LEVELS 8 /* fade steps, one draw batch each */
+
+#define PARTICLE_MUZZLE 0
+#define PARTICLE_SPARK 1
+#define PARTICLE_DEBRIS 2
+#define PARTICLE_KINDS 3
+
+/* dir is -1 or 1 for a burst to the left or right, 0 for all around */
+int particleEmit(int kind, float x, float y, float dir, int count);
+
+/* while muted nothing is emitted, for ticks being simulated over again */
+void particlesMute(int muted);
+
+void particlesUpdate(void);
+void particlesDraw(SDL_Renderer *renderer, float cameraX);
+
+#endif
@@ -0,0 +1,322 @@
+#include "replicate.h"
+#include <string.h>
+
+#define MAX_ADVANCE 1024 /* ticks behind, past every bullet's life */
+
+static void writeLE32(Uint8 *p, Uint32 v);
+static Uint32 readLE32(const Uint8 *p);
+static void advance(ReplClient *client, Uint32 ticks);
+
+static void writeLE32(Uint8 *p, Uint32 v) {
+  p[0] = (Uint8)v;
+  p[1] = (Uint8)(v >> 8);
+  p[2] = (Uint8)(v >> 16);
+  p[3] = (Uint8)(v >> 24);
+}
+
+static Uint32 readLE32(const Uint8 *p) {
+  return (Uint32)p[0] | (Uint32)p[1] << 8 | (Uint32)p[2] << 16 |
+         (Uint32)p[3] << 24;
+}
+
+/* rounds down, to 1 / 2^shift of a pixel */
+Sint32 replQuantize(Real v, int shift) {
+#ifdef FIXED_POINT
+  return v >> (16 - shift);
+#else
+  return (Sint32)SDL_floorf(v * (float)(1 << shift));
+#endif
+}
+
+Real replDequantize(Sint32 q, int shift) {
+#ifdef FIXED_POINT
+  return q * (1 << (16 - shift));
+#else
+  return (Real)q / (float)(1 << shift);
+#endif
+}
+
+/* float or 16.16, a Real is 32 bits either way */
+Uint32 replRealBits(Real v) {
+  Uint32 bits;
+  memcpy(&bits, &v, sizeof(bits));
+  return bits;
+}
+
+Real replRealFromBits(Uint32 bits) {
+  Real v;
+  memcpy(&v, &bits, sizeof(v));
+  return v;
+}
+
+void replWriteDelta(BitWriter *w, Sint32 delta) {
+  Uint32 folded;
+
+  if (delta < 0)
+    folded = ((Uint32)-(delta + 1) << 1) + 1;
+  else
+    folded = (Uint32)delta << 1;
+  bitsWriteGamma(w, folded + 1);
+}
+
+Sint32 replReadDelta(BitReader *r) {
+  Uint32 folded = bitsReadGamma(r) - 1;
+  return folded & 1 ? -(Sint32)(folded >> 1) - 1 : (Sint32)(folded >> 1);
+}
+
+void replWriteActor(BitWriter *w, const ReplActor *actor,
+                    const ReplActor *base) {
+  if (memcmp(actor, base, sizeof(*actor)) == 0) {
+    bitsWrite(w, 0, 1);
+    return;
+  }
+  bitsWrite(w, 1, 1);
+  replWriteDelta(w, actor->x - base->x);
+  replWriteDelta(w, actor->y - base->y);
+  bitsWrite(w, (Uint32)actor->sprite, 3);
+  bitsWrite(w, (Uint32)actor->flags, 3);
+}
+
+void replReadActor(BitReader *r, ReplActor *actor, const ReplActor *base) {
+  *actor = *base;
+  if (!bitsRead(r, 1))
+    return;
+  actor->x += replReadDelta(r);
+  actor->y += replReadDelta(r);
+  actor->sprite = (int)bitsRead(r, 3);
+  actor->flags = (int)bitsRead(r, 3);
+}
+
+void replWriteOwner(BitWriter *w, const ReplOwner *owner) {
+  bitsWrite(w, owner->input, 32);
+  bitsWrite(w, owner->x, 32);
+  bitsWrite(w, owner->y, 32);
+  bitsWrite(w, owner->dx, 32);
+  bitsWrite(w, owner->dy, 32);
+  bitsWrite(w, (Uint32)owner->flags, 3);
+}
+
+void replReadOwner(BitReader *r, ReplOwner *owner) {
+  owner->input = bitsRead(r, 32);
+  owner->x = bitsRead(r, 32);
+  owner->y = bitsRead(r, 32);
+  owner->dx = bitsRead(r, 32);
+  owner->dy = bitsRead(r, 32);
+  owner->flags = (int)bitsRead(r, 3);
+}
+
+void replRecordFromBullet(ReplRecord *rec, const Bullet *b) {
+  rec->serial = b->serial;
+  rec->x = replQuantize(b->x, REPL_POS_SHIFT);
+  rec->y = replQuantize(b->y, REPL_POS_SHIFT);
+  rec->dx = replQuantize(b->dx, REPL_VEL_SHIFT);
+  rec->dy = replQuantize(b->dy, REPL_VEL_SHIFT);
+  rec->life = b->life;
+}
+
+/* the serial gap is 1 to 65536, the next serial up costs a single bit */
+void replWriteRecord(BitWriter *w, const ReplRecord *rec, ReplRecord *prev) {
+  bitsWriteGamma(w, (Uint32)(Uint16)(rec->serial - prev->serial - 1) + 1);
+  replWriteDelta(w, rec->x - prev->x);
+  replWriteDelta(w, rec->y - prev->y);
+  bitsWriteSigned(w, rec->dx, REPL_VEL_BITS);
+  bitsWriteSigned(w, rec->dy, REPL_VEL_BITS);
+  replWriteDelta(w, rec->life - prev->life);
+  *prev = *rec;
+}
+
+void replReadRecord(BitReader *r, ReplRecord *rec, ReplRecord *prev) {
+  rec->serial = (Uint16)(prev->serial + bitsReadGamma(r));
+  rec->x = prev->x + replReadDelta(r);
+  rec->y = prev->y + replReadDelta(r);
+  rec->dx = bitsReadSigned(r, REPL_VEL_BITS);
+  rec->dy = bitsReadSigned(r, REPL_VEL_BITS);
+  rec->life = prev->life + (int)replReadDelta(r);
+  *prev = *rec;
+}
+
+void replClientStart(ReplClient *client, BulletPool *const pools[REPL_POOLS]) {
+  int i;
+
+  memset(client, 0, sizeof(*client));
+  for (i = 0; i < REPL_POOLS; i++) {
+    client->pools[i] = pools[i];
+    client->pools[i]->count = 0;
+  }
+}
+
+/* the bullets run on with the game's code, forgetting the ones that expire */
+static void advance(ReplClient *client, Uint32 ticks) {
+  int p, i;
+
+  if (ticks > MAX_ADVANCE) {
+    for (p = 0; p < REPL_POOLS; p++)
+      client->pools[p]->count = 0;
+    memset(client->have, 0, sizeof(client->have));
+    return;
+  }
+  for (p = 0; p < REPL_POOLS; p++) {
+    BulletPool *pool = client->pools[p];
+    Uint32 t;
+
+    for (t = 0; t < ticks; t++)
+      bulletsMove(pool, 0, 0, 0, 0);
+    for (i = 0; i < pool->count; i++)
+      if (pool->items[i].life <= 0)
+        client->have[p][pool->items[i].serial >> 3] &=
+            (Uint8) ~(1 << (pool->items[i].serial & 7));
+    bulletsRetire(pool);
+  }
+}
+
+int replClientApply(ReplClient *client, const Uint8 *data, int size) {
+  BitReader r;
+  ReplActor actors[REPL_ACTORS];
+  ReplActor zero[REPL_ACTORS];
+  const ReplActor *base = zero;
+  ReplOwner man;
+  int owner;
+  int waiting[REPL_POOLS];
+  int records = 0;
+  Uint32 tick, shift;
+  int p, i;
+
+  bitsReaderInit(&r, data, size);
+  tick = bitsRead(&r, 32);
+  if (client->started && (Sint32)(tick - client->tick) <= 0) {
+    client->stale++;
+    return -1;
+  }
+
+  memset(zero, 0, sizeof(zero));
+  if (bitsRead(&r, 1)) {
+    Uint32 baseline = tick - bitsReadGamma(&r);
+    int slot = (int)(baseline & (REPL_HISTORY - 1));
+    if (!client->started || client->historyTicks[slot] != baseline) {
+      client->errors++;
+      return -1;
+    }
+    base = client->history[slot];
+  }
+  for (i = 0; i < REPL_ACTORS; i++)
+    replReadActor(&r, &actors[i], &base[i]);
+  owner = (int)bitsRead(&r, 1);
+  if (owner)
+    replReadOwner(&r, &man);
+
+  for (p = 0; p < REPL_POOLS; p++) {
+    ReplRecord prev;
+
+    memset(&prev, 0, sizeof(prev));
+    while (!r.overflow && bitsRead(&r, 1)) {
+      if (records == REPL_RECORDS_MAX) {
+        r.overflow = 1;
+        break;
+      }
+      replReadRecord(&r, &client->records[records], &prev);
+      client->recordPools[records++] = p;
+    }
+    waiting[p] = (int)bitsRead(&r, REPL_COUNT_BITS);
+  }
+  if (r.overflow) {
+    client->errors++;
+    return -1;
+  }
+
+  /* whole and in order, now it can be applied */
+  shift = client->started ? tick - client->tick : MAX_ADVANCE + 1;
+  advance(client, shift);
+  for (i = 0; i < records; i++) {
+    const ReplRecord *rec = &client->records[i];
+    BulletPool *pool = client->pools[client->recordPools[i]];
+    Uint8 *have = &client->have[client->recordPools[i]][rec->serial >> 3];
+    Uint8 bit = (Uint8)(1 << (rec->serial & 7));
+    Bullet *b;
+
+    if ((*have & bit) || pool->count == BULLET_POOL_MAX || rec->life <= 0)
+      continue; /* a repeat, the bullet has not changed course */
+    *have |= bit;
+    b = &pool->items[pool->count++];
+    b->x = replDequantize(rec->x, REPL_POS_SHIFT);
+    b->y = replDequantize(rec->y, REPL_POS_SHIFT);
+    b->dx = replDequantize(rec->dx, REPL_VEL_SHIFT);
+    b->dy = replDequantize(rec->dy, REPL_VEL_SHIFT);
+    b->life = (Sint16)rec->life;
+    b->serial = rec->serial;
+  }
+
+  memcpy(client->actors, actors, sizeof(actors));
+  client->owner = owner;
+  if (owner)
+    client->man = man;
+  memcpy(client->history[tick & (REPL_HISTORY - 1)], actors, sizeof(actors));
+  client->historyTicks[tick & (REPL_HISTORY - 1)] = tick;
+  client->ackBits = shift >= 32 ? 0 : client->ackBits << shift;
+  if (shift <= 32)
+    client->ackBits |= 1u << (shift - 1);
+  client->tick = tick;
+  client->started = 1;
+
+  memcpy(client->waiting, waiting, sizeof(waiting));
+  if (!replClientComplete(client))
+    client->incomplete++;
+  client->packets++;
+  client->bytes += (unsigned long)size;
+  return 0;
+}
+
+int replClientAck(ReplClient *client, TickInput input, int view,
+                  Uint8 *data) {
+  Uint32 count = 1;
+  Uint8 *p = data + REPL_ACK_HEADER;
+  Uint32 n;
+
+  client->input++;
+  client->inputs[client->input & (REPL_INPUTS - 1)] = input;
+  if (client->owner)
+    count = SDL_min(client->input - client->man.input, REPL_INPUTS_SENT);
+
+  writeLE32(data, client->started ? client->tick : REPL_NO_TICK);
+  writeLE32(data + 4, client->started ? client->ackBits : 0);
+  data[8] = (Uint8)view;
+  data[9] = (Uint8)(view >> 8);
+  writeLE32(data + 10, client->input);
+  data[14] = (Uint8)count;
+  for (n = count; n > 0; n--) {
+    const TickInput *in =
+        &client->inputs[(client->input - n + 1) & (REPL_INPUTS - 1)];
+    *p++ = in->held;
+    *p++ = in->pressed;
+  }
+  return (int)(p - data);
+}
+
+int replReadAck(const Uint8 *data, int size, ReplAck *ack) {
+  int i;
+
+  if (size < REPL_ACK_HEADER)
+    return -1;
+  ack->tick = readLE32(data);
+  ack->ackBits = readLE32(data + 4);
+  ack->view = data[8] | data[9] << 8;
+  ack->input = readLE32(data + 10);
+  ack->inputCount = data[14];
+  if (ack->inputCount < 1 || ack->inputCount > REPL_INPUTS_SENT ||
+      ack->input < (Uint32)ack->inputCount ||
+      size != REPL_ACK_HEADER + 2 * ack->inputCount)
+    return -1;
+  for (i = 0; i < ack->inputCount; i++) {
+    ack->inputs[i].held = data[REPL_ACK_HEADER + 2 * i];
+    ack->inputs[i].pressed = data[REPL_ACK_HEADER + 2 * i + 1];
+  }
+  return 0;
+}
+
+int replClientComplete(const ReplClient *client) {
+  int p;
+
+  for (p = 0; p < REPL_POOLS; p++)
+    if (client->waiting[p] > 0)
+      return 0;
+  return 1;
+}
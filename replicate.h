@@ -0,0 +1,168 @@
+#ifndef REPLICATE_H
+#define REPLICATE_H
+
+#include "bits.h"
+#include "bullets.h"
+#include "input.h"
+
+/*
+ * The wire format of server snapshots, and the client end of it.
+ *
+ * Snapshots are bit-packed, gamma is an Elias gamma code of a delta folded
+ * to unsigned (0, -1, 1, -2, ... as 1, 2, 3, 4, ...):
+ *
+ *   tick 32 | has baseline 1 | [gamma (tick - baseline)]
+ *   per actor:  changed 1 | [gamma x | gamma y | sprite 3 | flags 3]
+ *   owner 1 | [input 32 | x 32 | y 32 | dx 32 | dy 32 | flags 3]
+ *   per pool:   { 1 | gamma serial | gamma x | gamma y | dx 12 | dy 12 |
+ *                 gamma life } ... 0 | waiting 13
+ *
+ * Actors are delta coded against the baseline, the newest snapshot the
+ * client has acknowledged, or against zero without one. Bullets fly in
+ * straight lines, so each is sent once, as a record of where it is, its
+ * velocity and its life left, and the client moves it on from there with
+ * the game's own bullet code; a record is only repeated when its packet
+ * was lost. Records are coded against the record before them, serials
+ * ascending, so the ring of bullets from one shot costs little more than
+ * its velocities. Only bullets near the client's view are sent, most
+ * pressing first, and the ones that did not fit are counted as waiting;
+ * with nothing waiting the client has everything it can see.
+ *
+ * Positions go in quarter pixels, velocities in 1/256ths of a pixel a
+ * tick; a bullet drifts under a pixel from the server's over its life.
+ *
+ * The client controlling the man also gets the man exactly, as the bits of
+ * his Reals, after the newest of its inputs the server has applied. It
+ * predicts the man from its own inputs with the game's code, and with the
+ * exact state it can check that prediction and replay from it.
+ *
+ * Clients answer every tick they run with
+ *
+ *   LE32 newest tick applied | LE32 ack bits | LE16 view |
+ *   LE32 newest input | count | count * (held | pressed)
+ *
+ * where ack bit n stands for the snapshot of tick - 1 - n, the tick is
+ * REPL_NO_TICK until the first snapshot arrives, and the view is the left
+ * edge of the client's screen in pixels. Inputs are numbered from 1, one a
+ * tick. The controlling client repeats every input the server has not
+ * confirmed applying, oldest first, up to REPL_INPUTS_SENT, so a lost
+ * packet costs no input unless the server stays silent for that long;
+ * the others send only the newest.
+ */
+
+#define REPL_ACTORS 3     /* the man, the enemy, the rival */
+#define REPL_POOLS 3      /* player, enemy and rival bullets */
+#define REPL_HISTORY 32   /* snapshots a client can acknowledge */
+#define REPL_SERIALS 65536
+#define REPL_POS_SHIFT 2  /* quarter pixels */
+#define REPL_VEL_SHIFT 8  /* 1/256 pixel a tick */
+#define REPL_VEL_BITS 12  /* signed, up to 8 pixels a tick */
+#define REPL_COUNT_BITS 13
+#define REPL_RECORD_BITS 192 /* the most one bullet record can take */
+#define REPL_RECORDS_MAX 512 /* bullet records in one snapshot */
+#define REPL_INPUTS 64      /* the client's ring of inputs, power of two */
+#define REPL_INPUTS_SENT 32 /* repeated in an answer at most */
+#define REPL_ACK_HEADER 15
+#define REPL_ACK_MAX (REPL_ACK_HEADER + 2 * REPL_INPUTS_SENT)
+#define REPL_NO_TICK 0xffffffffu
+
+#define REPL_VISIBLE 1
+#define REPL_FACING_LEFT 2
+#define REPL_ALIVE 4
+
+#define REPL_WALKING 1 /* owner flags */
+#define REPL_SHOOTING 2
+#define REPL_TURNED 4 /* facing left */
+
+/* an actor as sent, position quantized */
+typedef struct {
+  Sint32 x, y;
+  int sprite; /* 0 to 7 */
+  int flags;  /* REPL_ */
+} ReplActor;
+
+/* the man as sent to the client controlling him, Reals as bits */
+typedef struct {
+  Uint32 input; /* newest of the client's inputs applied, 0 for none */
+  Uint32 x, y, dx, dy;
+  int flags; /* REPL_WALKING and so on */
+} ReplOwner;
+
+/* an answer from a client */
+typedef struct {
+  Uint32 tick; /* REPL_NO_TICK for none */
+  Uint32 ackBits;
+  int view;
+  Uint32 input; /* the newest, the others count down from it */
+  int inputCount;
+  TickInput inputs[REPL_INPUTS_SENT]; /* oldest first */
+} ReplAck;
+
+/* a bullet as sent */
+typedef struct {
+  Uint16 serial;
+  Sint32 x, y, dx, dy;
+  int life;
+} ReplRecord;
+
+typedef struct {
+  BulletPool *pools[REPL_POOLS]; /* the client's bullets, the caller's */
+  Uint32 tick;                   /* newest snapshot applied */
+  Uint32 ackBits;
+  int started;
+  ReplActor actors[REPL_ACTORS];
+  int owner;     /* the newest snapshot made this client control the man */
+  ReplOwner man; /* and the man it sent */
+  TickInput inputs[REPL_INPUTS]; /* by number */
+  Uint32 input;                  /* the newest */
+  ReplActor history[REPL_HISTORY][REPL_ACTORS]; /* baselines, by tick */
+  Uint32 historyTicks[REPL_HISTORY];
+  Uint8 have[REPL_POOLS][REPL_SERIALS / 8]; /* serials in the pools */
+  int waiting[REPL_POOLS];                  /* bullets the server owes */
+  ReplRecord records[REPL_RECORDS_MAX];     /* decoded, not yet applied */
+  int recordPools[REPL_RECORDS_MAX];
+  unsigned long packets, bytes, stale, errors, incomplete;
+} ReplClient;
+
+Sint32 replQuantize(Real v, int shift);
+Real replDequantize(Sint32 q, int shift);
+
+/* a Real's exact bits and back */
+Uint32 replRealBits(Real v);
+Real replRealFromBits(Uint32 bits);
+
+void replWriteDelta(BitWriter *w, Sint32 delta);
+Sint32 replReadDelta(BitReader *r);
+
+void replWriteActor(BitWriter *w, const ReplActor *actor,
+                    const ReplActor *base);
+void replReadActor(BitReader *r, ReplActor *actor, const ReplActor *base);
+
+/* records are coded against the one before, prev starts out zeroed */
+void replRecordFromBullet(ReplRecord *rec, const Bullet *b);
+void replWriteRecord(BitWriter *w, const ReplRecord *rec, ReplRecord *prev);
+void replReadRecord(BitReader *r, ReplRecord *rec, ReplRecord *prev);
+
+void replWriteOwner(BitWriter *w, const ReplOwner *owner);
+void replReadOwner(BitReader *r, ReplOwner *owner);
+
+void replClientStart(ReplClient *client, BulletPool *const pools[REPL_POOLS]);
+
+/*
+ * Moves the client's bullets on to the snapshot's tick and applies it.
+ * Returns 0, or -1 for a snapshot that is stale, truncated or coded against
+ * a baseline the client does not have; those are not acknowledged.
+ */
+int replClientApply(ReplClient *client, const Uint8 *data, int size);
+
+/*
+ * Numbers the tick's input and writes the answer to the server, up to
+ * REPL_ACK_MAX bytes, returns its size.
+ */
+int replClientAck(ReplClient *client, TickInput input, int view, Uint8 *data);
+int replReadAck(const Uint8 *data, int size, ReplAck *ack);
+
+/* nothing it can see is waiting on the server, the last snapshot said */
+int replClientComplete(const ReplClient *client);
+
+#endif
@@ -0,0 +1,180 @@
+#include "ring.h"
+#include <string.h>
+
+static int loadAcquire(SDL_atomic_t *a);
+static void storeRelease(SDL_atomic_t *a, int v);
+static int claim(SDL_atomic_t *a, int expected, int desired);
+static void copyIn(Uint8 *items, Uint32 mask, int itemSize, Uint32 at,
+                   const void *from, int count);
+static void copyOut(const Uint8 *items, Uint32 mask, int itemSize, Uint32 at,
+                    void *to, int count);
+
+/*
+ * With GCC and Clang the indices are plain acquire loads and release
+ * stores, free on x86, and ThreadSanitizer understands them; SDL's
+ * atomics with its barriers are the portable fallback.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+static int loadAcquire(SDL_atomic_t *a) {
+  return __atomic_load_n(&a->value, __ATOMIC_ACQUIRE);
+}
+
+static void storeRelease(SDL_atomic_t *a, int v) {
+  __atomic_store_n(&a->value, v, __ATOMIC_RELEASE);
+}
+
+static int claim(SDL_atomic_t *a, int expected, int desired) {
+  return __atomic_compare_exchange_n(&a->value, &expected, desired, 0,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+}
+#else
+static int loadAcquire(SDL_atomic_t *a) {
+  int v = SDL_AtomicGet(a);
+  SDL_MemoryBarrierAcquire();
+  return v;
+}
+
+static void storeRelease(SDL_atomic_t *a, int v) {
+  SDL_MemoryBarrierRelease();
+  SDL_AtomicSet(a, v);
+}
+
+static int claim(SDL_atomic_t *a, int expected, int desired) {
+  return SDL_AtomicCAS(a, expected, desired) == SDL_TRUE;
+}
+#endif
+
+/* at most two copies, the second one after wrapping round */
+static void copyIn(Uint8 *items, Uint32 mask, int itemSize, Uint32 at,
+                   const void *from, int count) {
+  int first = SDL_min(count, (int)(mask + 1 - (at & mask)));
+
+  memcpy(items + (size_t)(at & mask) * (size_t)itemSize, from,
+         (size_t)first * (size_t)itemSize);
+  if (count > first)
+    memcpy(items, (const Uint8 *)from + (size_t)first * (size_t)itemSize,
+           (size_t)(count - first) * (size_t)itemSize);
+}
+
+static void copyOut(const Uint8 *items, Uint32 mask, int itemSize, Uint32 at,
+                    void *to, int count) {
+  int first = SDL_min(count, (int)(mask + 1 - (at & mask)));
+
+  memcpy(to, items + (size_t)(at & mask) * (size_t)itemSize,
+         (size_t)first * (size_t)itemSize);
+  if (count > first)
+    memcpy((Uint8 *)to + (size_t)first * (size_t)itemSize, items,
+           (size_t)(count - first) * (size_t)itemSize);
+}
+
+void ringInit(Ring *ring, void *items, int itemSize, int capacity) {
+  memset(ring, 0, sizeof(*ring));
+  ring->items = (Uint8 *)items;
+  ring->itemSize = itemSize;
+  ring->mask = (Uint32)capacity - 1;
+}
+
+int ringPush(Ring *ring, const void *items, int count) {
+  Uint32 head = (Uint32)ring->head.value; /* nobody else writes it */
+  int room = (int)(ring->mask + 1 - (head - ring->tailSeen));
+
+  if (room < count) {
+    ring->tailSeen = (Uint32)loadAcquire(&ring->tail);
+    room = (int)(ring->mask + 1 - (head - ring->tailSeen));
+  }
+  count = SDL_min(count, room);
+  if (count <= 0)
+    return 0;
+  copyIn(ring->items, ring->mask, ring->itemSize, head, items, count);
+  /* the items before the head that shows them */
+  storeRelease(&ring->head, (int)(head + (Uint32)count));
+  return count;
+}
+
+int ringPop(Ring *ring, void *items, int count) {
+  Uint32 tail = (Uint32)ring->tail.value;
+  int ready = (int)(ring->headSeen - tail);
+
+  if (ready < count) {
+    ring->headSeen = (Uint32)loadAcquire(&ring->head);
+    ready = (int)(ring->headSeen - tail);
+  }
+  count = SDL_min(count, ready);
+  if (count <= 0)
+    return 0;
+  if (items)
+    copyOut(ring->items, ring->mask, ring->itemSize, tail, items, count);
+  /* done reading the slots before handing them back */
+  storeRelease(&ring->tail, (int)(tail + (Uint32)count));
+  return count;
+}
+
+void *ringPeek(Ring *ring) {
+  Uint32 tail = (Uint32)ring->tail.value;
+
+  if (ring->headSeen == tail) {
+    ring->headSeen = (Uint32)loadAcquire(&ring->head);
+    if (ring->headSeen == tail)
+      return NULL;
+  }
+  return ring->items + (size_t)(tail & ring->mask) * (size_t)ring->itemSize;
+}
+
+int ringCount(Ring *ring) {
+  return (int)((Uint32)loadAcquire(&ring->head) -
+               (Uint32)loadAcquire(&ring->tail));
+}
+
+void ringMPInit(RingMP *ring, void *items, SDL_atomic_t *published,
+                int itemSize, int capacity) {
+  int i;
+
+  memset(ring, 0, sizeof(*ring));
+  ring->items = (Uint8 *)items;
+  ring->published = published;
+  ring->itemSize = itemSize;
+  ring->mask = (Uint32)capacity - 1;
+  /* slot i is next written as index i, 0 means it never was */
+  for (i = 0; i < capacity; i++)
+    published[i].value = 0;
+}
+
+int ringMPPush(RingMP *ring, const void *items, int count) {
+  Uint32 head;
+  int i;
+
+  if (count <= 0 || count > (int)(ring->mask + 1))
+    return 0;
+  do {
+    head = (Uint32)loadAcquire(&ring->head);
+    if (head - (Uint32)loadAcquire(&ring->tail) + (Uint32)count >
+        ring->mask + 1)
+      return 0;
+  } while (!claim(&ring->head, (int)head, (int)(head + (Uint32)count)));
+
+  /* the slots are ours; each is published once written */
+  for (i = 0; i < count; i++) {
+    Uint32 at = head + (Uint32)i;
+    memcpy(ring->items + (size_t)(at & ring->mask) * (size_t)ring->itemSize,
+           (const Uint8 *)items + (size_t)i * (size_t)ring->itemSize,
+           (size_t)ring->itemSize);
+    storeRelease(&ring->published[at & ring->mask], (int)(at + 1));
+  }
+  return count;
+}
+
+int ringMPPop(RingMP *ring, void *items, int count) {
+  Uint32 tail = (Uint32)ring->tail.value;
+  int n = 0;
+
+  /* stops at the first slot claimed but not yet written */
+  while (n < count && (Uint32)loadAcquire(
+                          &ring->published[(tail + (Uint32)n) & ring->mask]) ==
+                          tail + (Uint32)n + 1)
+    n++;
+  if (n == 0)
+    return 0;
+  copyOut(ring->items, ring->mask, ring->itemSize, tail, items, n);
+  storeRelease(&ring->tail, (int)(tail + (Uint32)n));
+  return n;
+}
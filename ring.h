@@ -0,0 +1,73 @@
+#ifndef RING_H
+#define RING_H
+
+#include <SDL2/SDL.h>
+
+/*
+ * Lock-free ring buffers for handing fixed-size items between threads.
+ *
+ * Ring has a single producer and a single consumer. RingMP takes any number
+ * of producer threads and one consumer: producers claim slots with a
+ * compare and swap on the head and publish each slot on its own, the
+ * consumer takes slots in order as they are published.
+ *
+ * Capacity is a power of two and the storage is the caller's, so nothing
+ * is allocated. Indices run free and wrap as unsigned. The ones written by
+ * each side are a cache line apart, each next to that side's cached copy
+ * of the other's, so producer and consumer only touch each other's line
+ * when the cached copy says the ring looks full or empty. Pushes and
+ * pops take a batch at a time and return how many went through, never
+ * waiting.
+ */
+
+#define RING_CACHE_LINE 64
+
+typedef struct {
+  SDL_atomic_t head; /* the producer's */
+  Uint32 tailSeen;   /* the producer's latest look at tail */
+  char producerPad[RING_CACHE_LINE - sizeof(SDL_atomic_t) - sizeof(Uint32)];
+  SDL_atomic_t tail; /* the consumer's */
+  Uint32 headSeen;
+  char consumerPad[RING_CACHE_LINE - sizeof(SDL_atomic_t) - sizeof(Uint32)];
+  Uint8 *items;
+  int itemSize;
+  Uint32 mask; /* capacity - 1 */
+} Ring;
+
+typedef struct {
+  SDL_atomic_t head; /* claimed by the producers together */
+  char producerPad[RING_CACHE_LINE - sizeof(SDL_atomic_t)];
+  SDL_atomic_t tail; /* the consumer's */
+  char consumerPad[RING_CACHE_LINE - sizeof(SDL_atomic_t)];
+  SDL_atomic_t *published; /* per slot, the index + 1 last written to it */
+  Uint8 *items;
+  int itemSize;
+  Uint32 mask;
+} RingMP;
+
+/* items holds capacity items of itemSize bytes, capacity a power of two */
+void ringInit(Ring *ring, void *items, int itemSize, int capacity);
+
+/* as many of the count items as fit, returns how many */
+int ringPush(Ring *ring, const void *items, int count);
+
+/* up to count items, oldest first, returns how many; NULL items drops them */
+int ringPop(Ring *ring, void *items, int count);
+
+/* the oldest item without taking it, NULL when empty; consumer only */
+void *ringPeek(Ring *ring);
+
+/* items waiting, exact from either side's own view */
+int ringCount(Ring *ring);
+
+/* published holds capacity counters */
+void ringMPInit(RingMP *ring, void *items, SDL_atomic_t *published,
+                int itemSize, int capacity);
+
+/* all count items or none, returns count or 0; any thread */
+int ringMPPush(RingMP *ring, const void *items, int count);
+
+/* up to count published items, oldest first; the consumer thread only */
+int ringMPPop(RingMP *ring, void *items, int count);
+
+#endif
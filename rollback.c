@@ -0,0 +1,222 @@
+#include "rollback.h"
+#include <stdio.h>
+#include <string.h>
+
+#define NO_ROLLBACK 0xffffffffu
+#define HEADER_SIZE 17 /* first, ack, tick, advantage, count */
+#define WAIT_AHEAD 2   /* ticks ahead of the peer before holding back */
+
+static void writeLE32(Uint8 *p, Uint32 v);
+static Uint32 readLE32(const Uint8 *p);
+static TickInput predict(const Rollback *session);
+static void receive(Rollback *session);
+static void resimulate(Rollback *session);
+static void sendInputs(Rollback *session);
+
+static void writeLE32(Uint8 *p, Uint32 v) {
+  p[0] = (Uint8)v;
+  p[1] = (Uint8)(v >> 8);
+  p[2] = (Uint8)(v >> 16);
+  p[3] = (Uint8)(v >> 24);
+}
+
+static Uint32 readLE32(const Uint8 *p) {
+  return (Uint32)p[0] | (Uint32)p[1] << 8 | (Uint32)p[2] << 16 |
+         (Uint32)p[3] << 24;
+}
+
+/* the remote keeps holding what they held, a press is never repeated */
+static TickInput predict(const Rollback *session) {
+  TickInput input;
+
+  input.held = 0;
+  input.pressed = 0;
+  if (session->remoteTick > 0)
+    input.held = session->inputs[1 - session->local]
+                                [(session->remoteTick - 1) % ROLLBACK_INPUTS]
+                                    .held;
+  return input;
+}
+
+static void receive(Rollback *session) {
+  Uint8 packet[NET_PACKET_MAX];
+  TickInput *remote = session->inputs[1 - session->local];
+  int size;
+
+  while ((size = netReceive(session->link, packet, sizeof(packet))) >= 0) {
+    Uint32 first, ack, now, t;
+    int count, i;
+
+    if (size < HEADER_SIZE)
+      continue;
+    first = readLE32(packet);
+    ack = readLE32(packet + 4);
+    now = readLE32(packet + 8);
+    count = packet[16];
+    if (HEADER_SIZE + 2 * count > size)
+      continue;
+
+    if ((Sint32)(ack - session->remoteAck) > 0)
+      session->remoteAck = ack;
+    if ((Sint32)(now - session->remoteNow) >= 0) {
+      session->remoteNow = now;
+      session->remoteAdvantage = (int)(Sint32)readLE32(packet + 12);
+      session->localAdvantage = (int)(Sint32)(now - session->tick);
+    }
+
+    /* only the input that extends what we know, packets repeat the rest */
+    for (i = 0; i < count; i++) {
+      TickInput input;
+      TickInput *slot;
+
+      t = first + (Uint32)i;
+      if (t != session->remoteTick)
+        continue;
+      input.held = packet[HEADER_SIZE + 2 * i];
+      input.pressed = packet[HEADER_SIZE + 2 * i + 1];
+      slot = &remote[t % ROLLBACK_INPUTS];
+      if (t < session->tick &&
+          (slot->held != input.held || slot->pressed != input.pressed) &&
+          t < session->rollbackFrom)
+        session->rollbackFrom = t;
+      *slot = input;
+      session->remoteTick++;
+    }
+  }
+}
+
+/* back to the first wrong tick and forward again to where we were */
+static void resimulate(Rollback *session) {
+  const RollbackGame *game = &session->game;
+  Uint32 from = session->rollbackFrom;
+  Uint64 start = SDL_GetPerformanceCounter();
+  double us;
+  Uint32 t;
+
+  game->load(game->context, &session->snapshots[from % ROLLBACK_WINDOW]);
+  for (t = from; t < session->tick; t++) {
+    TickInput inputs[2];
+
+    if (t >= session->remoteTick)
+      session->inputs[1 - session->local][t % ROLLBACK_INPUTS] =
+          predict(session);
+    if (t != from)
+      game->save(game->context, &session->snapshots[t % ROLLBACK_WINDOW]);
+    inputs[0] = session->inputs[0][t % ROLLBACK_INPUTS];
+    inputs[1] = session->inputs[1][t % ROLLBACK_INPUTS];
+    game->advance(game->context, inputs, 1);
+  }
+
+  us = (double)(SDL_GetPerformanceCounter() - start) * 1e6 /
+       (double)SDL_GetPerformanceFrequency();
+  session->stats.rollbacks++;
+  session->stats.resimulated += session->tick - from;
+  session->stats.deepest =
+      SDL_max(session->stats.deepest, (int)(session->tick - from));
+  session->stats.resimUs += us;
+  if (us > session->stats.worstUs)
+    session->stats.worstUs = us;
+  session->rollbackFrom = NO_ROLLBACK;
+}
+
+/* everything the peer has not acknowledged, oldest first */
+static void sendInputs(Rollback *session) {
+  Uint8 packet[NET_PACKET_MAX];
+  const TickInput *local = session->inputs[session->local];
+  Uint32 first = session->remoteAck;
+  int count = (int)(session->tick - first);
+  int i;
+
+  writeLE32(packet, first);
+  writeLE32(packet + 4, session->remoteTick);
+  writeLE32(packet + 8, session->tick);
+  writeLE32(packet + 12, (Uint32)session->localAdvantage);
+  packet[16] = (Uint8)count;
+  for (i = 0; i < count; i++) {
+    const TickInput *input = &local[(first + (Uint32)i) % ROLLBACK_INPUTS];
+    packet[HEADER_SIZE + 2 * i] = input->held;
+    packet[HEADER_SIZE + 2 * i + 1] = input->pressed;
+  }
+  netSend(session->link, packet, HEADER_SIZE + 2 * count);
+}
+
+void rollbackStart(Rollback *session, const RollbackGame *game, NetLink *link,
+                   int local) {
+  memset(session, 0, sizeof(*session));
+  session->game = *game;
+  session->link = link;
+  session->local = local;
+  session->rollbackFrom = NO_ROLLBACK;
+}
+
+void rollbackPoll(Rollback *session) {
+  receive(session);
+  if (session->rollbackFrom != NO_ROLLBACK)
+    resimulate(session);
+  sendInputs(session);
+}
+
+int rollbackTick(Rollback *session, TickInput local) {
+  const RollbackGame *game = &session->game;
+  Uint32 t = session->tick;
+  TickInput inputs[2];
+
+  receive(session);
+  if (session->rollbackFrom != NO_ROLLBACK)
+    resimulate(session);
+
+  /* out of snapshots, or of history to resend; the peer has to catch up */
+  if ((Sint32)(t - session->remoteTick) >= ROLLBACK_WINDOW ||
+      (Sint32)(t - session->remoteAck) >= ROLLBACK_INPUTS - 1) {
+    session->stats.stalls++;
+    session->carry |= local.pressed;
+    sendInputs(session);
+    return 0;
+  }
+
+  /*
+   * Both advantages include the same latency, half their difference is how
+   * far this side runs ahead. One tick of waiting per packet from the peer.
+   */
+  if (session->remoteAdvantage - session->localAdvantage >= 2 * WAIT_AHEAD) {
+    session->stats.waits++;
+    session->carry |= local.pressed;
+    session->remoteAdvantage = session->localAdvantage;
+    sendInputs(session);
+    return 0;
+  }
+
+  local.pressed |= session->carry;
+  session->carry = 0;
+  session->inputs[session->local][t % ROLLBACK_INPUTS] = local;
+  if (t >= session->remoteTick)
+    session->inputs[1 - session->local][t % ROLLBACK_INPUTS] =
+        predict(session);
+
+  game->save(game->context, &session->snapshots[t % ROLLBACK_WINDOW]);
+  inputs[0] = session->inputs[0][t % ROLLBACK_INPUTS];
+  inputs[1] = session->inputs[1][t % ROLLBACK_INPUTS];
+  game->advance(game->context, inputs, 0);
+  session->tick++;
+  session->stats.ticks++;
+
+  sendInputs(session);
+  return 1;
+}
+
+void rollbackPrintStats(const Rollback *session) {
+  const RollbackStats *s = &session->stats;
+  const NetLink *link = session->link;
+
+  printf("rollback: %lu ticks, %lu rollbacks (%.1f%% of ticks), %lu ticks "
+         "resimulated, %d deepest\n",
+         s->ticks, s->rollbacks,
+         s->ticks ? 100.0 * (double)s->rollbacks / (double)s->ticks : 0.0,
+         s->resimulated, s->deepest);
+  printf("rollback: resimulation %.1f us mean, %.1f us worst; %lu stalls, "
+         "%lu waits\n",
+         s->rollbacks ? s->resimUs / (double)s->rollbacks : 0.0, s->worstUs,
+         s->stalls, s->waits);
+  printf("net: %lu sent, %lu dropped, %lu received\n", link->sent,
+         link->dropped, link->received);
+}
@@ -0,0 +1,73 @@
+#ifndef ROLLBACK_H
+#define ROLLBACK_H
+
+#include "input.h"
+#include "net.h"
+#include "snapshot.h"
+
+/*
+ * Two player rollback netplay, the way GGPO does it. Local input is
+ * simulated on the tick it is read; the remote player is predicted to keep
+ * holding whatever they last sent. When their real input turns up and
+ * differs, the world is restored from the snapshot of the first wrong tick
+ * and run forward again before the frame is drawn. The game only waits when
+ * the peer falls ROLLBACK_WINDOW ticks behind, or to let a slower peer
+ * catch up.
+ *
+ * Every packet repeats all the input the peer has not acknowledged, so a
+ * lost or late packet costs a deeper rollback rather than a stall.
+ */
+
+#define ROLLBACK_WINDOW 16  /* ticks of prediction, one snapshot each */
+#define ROLLBACK_INPUTS 128 /* input history, power of two */
+
+typedef struct {
+  void *context; /* passed back to every callback */
+  void (*save)(void *context, Snapshot *snap);
+  void (*load)(void *context, const Snapshot *snap);
+  /* one tick with both players' input, replaying when rolled back */
+  void (*advance)(void *context, const TickInput inputs[2], int replaying);
+} RollbackGame;
+
+typedef struct {
+  unsigned long ticks;
+  unsigned long rollbacks;
+  unsigned long resimulated; /* ticks run again */
+  unsigned long stalls;      /* too far ahead of the peer's input */
+  unsigned long waits;       /* held back to let the peer catch up */
+  int deepest;
+  double resimUs, worstUs;
+} RollbackStats;
+
+typedef struct {
+  RollbackGame game;
+  NetLink *link;
+  int local;          /* the player this side controls, 0 or 1 */
+  Uint32 tick;        /* next tick to run */
+  Uint32 remoteTick;  /* remote input is known before this tick */
+  Uint32 remoteAck;   /* the peer has our input before this tick */
+  Uint32 remoteNow;   /* the peer's tick as of its latest packet */
+  int localAdvantage; /* remoteNow - tick when that packet arrived */
+  int remoteAdvantage;
+  Uint32 rollbackFrom; /* first mispredicted tick */
+  Uint8 carry;         /* presses read while waiting */
+  TickInput inputs[2][ROLLBACK_INPUTS];
+  Snapshot snapshots[ROLLBACK_WINDOW];
+  RollbackStats stats;
+} Rollback;
+
+void rollbackStart(Rollback *session, const RollbackGame *game, NetLink *link,
+                   int local);
+
+/*
+ * Exchanges input, rolls back if a prediction was wrong, then runs the
+ * next tick with the local input. Returns 0 when it had to wait instead.
+ */
+int rollbackTick(Rollback *session, TickInput local);
+
+/* the exchange and rollback only, no new tick */
+void rollbackPoll(Rollback *session);
+
+void rollbackPrintStats(const Rollback *session);
+
+#endif
@@ -0,0 +1,465 @@
+#include "server.h"
+#include "grid.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * What a client has of a bullet, one Uint16 per pool and serial. Until the
+ * record is sent the low bits are the priority it has built up.
+ */
+#define STATE_HELD 0x8000 /* acknowledged */
+#define STATE_SENT 0x4000 /* record sent on the tick in the low bits */
+#define STATE_TICK 0x3fff
+#define RESEND_MARGIN 2 /* ticks past the round trip before sending again */
+#define PRIORITY_SCREEN 4 /* gained a tick waiting on screen */
+#define PRIORITY_MARGIN 1 /* and in the margin */
+#define RECORD_BITS_MIN 29 /* the cheapest bullet record */
+#define INPUTS 64 /* ring of a client's inputs, power of two */
+#define INPUT_BACKLOG 8 /* inputs queued at most, older ones are dropped */
+
+typedef struct {
+  Uint16 port;   /* 0 for a free slot */
+  Uint32 heard;  /* SDL_GetTicks() of the latest packet */
+  Uint32 joined; /* the earliest client controls the man */
+  TickInput inputs[INPUTS];
+  Uint32 inputNumbers[INPUTS]; /* which input each slot holds */
+  Uint32 input;                /* newest applied */
+  Uint32 newestInput;          /* newest received */
+  Uint32 acked;  /* newest snapshot it holds, REPL_NO_TICK for none */
+  int roundTrip; /* ticks */
+  int view;      /* left edge of its screen */
+  Uint32 sentTicks[REPL_HISTORY];
+  ReplActor sentActors[REPL_HISTORY][REPL_ACTORS];
+  int sentCount[REPL_HISTORY]; /* -1 once acknowledged */
+  Uint32 sent[REPL_HISTORY][REPL_RECORDS_MAX]; /* pool << 16 | serial */
+  Uint16 *state;
+  unsigned long packets, bytes, fullActors, records, lost;
+  unsigned long considered, waiting; /* bullets in view, left waiting */
+  int maxBytes;
+} Client;
+
+static Client clients[SERVER_CLIENTS];
+static Client *controller;
+static Uint16 *states;
+static NetLink serverLink;
+static Uint32 now; /* tick of the latest broadcast */
+static Uint32 joins;
+static Uint16 nextSerial[REPL_POOLS];
+static int broadcasting;
+static int budget;
+static Grid grids[REPL_POOLS];
+static Uint8 packet[NET_PACKET_MAX];
+static Uint16 relevant[BULLET_POOL_MAX];
+static Uint32 candidates[REPL_POOLS * BULLET_POOL_MAX];
+
+static unsigned long statTicks, statBullets;
+static unsigned long statLate, statCaughtUp, statDropped;
+static double statUs, statWorstUs, statSendUs;
+
+static Client *findClient(Uint16 port);
+static void receiveInputs(Client *c, const ReplAck *ack);
+static void acknowledge(Client *c, Uint32 tick, Uint32 bits);
+static int compareCandidates(const void *a, const void *b);
+static int collect(Client *c, int waiting[REPL_POOLS]);
+static void sendSnapshot(Client *c, const ReplActor actors[REPL_ACTORS],
+                         const ReplOwner *man,
+                         BulletPool *const pools[REPL_POOLS]);
+
+int serverOpen(Uint16 port, const NetConditions *conditions, int bytes) {
+  int i;
+
+  states = (Uint16 *)calloc((size_t)SERVER_CLIENTS * REPL_POOLS * REPL_SERIALS,
+                            sizeof(Uint16));
+  if (!states)
+    return -1;
+  if (netOpen(&serverLink, port, 0, conditions) != 0) {
+    free(states);
+    states = NULL;
+    return -1;
+  }
+  memset(clients, 0, sizeof(clients));
+  for (i = 0; i < SERVER_CLIENTS; i++)
+    clients[i].state = states + (size_t)i * REPL_POOLS * REPL_SERIALS;
+  controller = NULL;
+  broadcasting = 0;
+  budget = SDL_max(64, SDL_min(bytes, NET_PACKET_MAX));
+  statTicks = statBullets = 0;
+  statLate = statCaughtUp = statDropped = 0;
+  statUs = statWorstUs = statSendUs = 0;
+  return 0;
+}
+
+void serverClose(void) {
+  netClose(&serverLink);
+  free(states);
+  states = NULL;
+}
+
+/* the client on that port, joining it if there is room */
+static Client *findClient(Uint16 port) {
+  Client *c = NULL;
+  int i;
+
+  for (i = 0; i < SERVER_CLIENTS; i++) {
+    if (clients[i].port == port)
+      return &clients[i];
+    if (!c && clients[i].port == 0)
+      c = &clients[i];
+  }
+  if (!c)
+    return NULL;
+
+  memset(c, 0, offsetof(Client, state));
+  memset(c->state, 0, sizeof(Uint16) * REPL_POOLS * REPL_SERIALS);
+  c->port = port;
+  c->joined = joins++;
+  c->acked = REPL_NO_TICK;
+  for (i = 0; i < REPL_HISTORY; i++)
+    c->sentTicks[i] = REPL_NO_TICK;
+  return c;
+}
+
+/* queued by number, the ones already applied or overtaken are of no use */
+static void receiveInputs(Client *c, const ReplAck *ack) {
+  Uint32 number = ack->input - (Uint32)ack->inputCount;
+  int i;
+
+  for (i = 0; i < ack->inputCount; i++) {
+    int slot = (int)(++number & (INPUTS - 1));
+    if ((Sint32)(number - c->input) <= 0)
+      continue;
+    c->inputs[slot] = ack->inputs[i];
+    c->inputNumbers[slot] = number;
+  }
+  if ((Sint32)(ack->input - c->newestInput) > 0)
+    c->newestInput = ack->input;
+}
+
+/* every snapshot the ack covers, its bullets are now held */
+static void acknowledge(Client *c, Uint32 tick, Uint32 bits) {
+  int n, i;
+
+  if (tick == REPL_NO_TICK || (Sint32)(now - tick) < 0)
+    return;
+  for (n = -1; n < 32; n++) {
+    Uint32 t = tick - 1 - (Uint32)n;
+    int slot = (int)(t & (REPL_HISTORY - 1));
+
+    if (n >= 0 && !(bits >> n & 1))
+      continue;
+    if (c->sentTicks[slot] != t || c->sentCount[slot] < 0)
+      continue;
+    for (i = 0; i < c->sentCount[slot]; i++) {
+      Uint16 *state = &c->state[c->sent[slot][i]];
+      if (*state & STATE_SENT)
+        *state = STATE_HELD;
+    }
+    c->sentCount[slot] = -1;
+  }
+  if (c->acked == REPL_NO_TICK || (Sint32)(tick - c->acked) > 0) {
+    c->acked = tick;
+    c->roundTrip = (int)(now - tick);
+  }
+}
+
+void serverPoll(void) {
+  Uint8 data[NET_PACKET_MAX];
+  Uint32 time = SDL_GetTicks();
+  Uint16 port;
+  int size, i;
+
+  while ((size = netReceiveFrom(&serverLink, data, sizeof(data), &port)) >=
+         0) {
+    ReplAck ack;
+    Client *c;
+
+    if (replReadAck(data, size, &ack) != 0)
+      continue;
+    c = findClient(port);
+    if (!c)
+      continue;
+    c->heard = time;
+    c->view = ack.view;
+    receiveInputs(c, &ack);
+    acknowledge(c, ack.tick, ack.ackBits);
+  }
+
+  for (i = 0; i < SERVER_CLIENTS; i++) {
+    if (clients[i].port && time - clients[i].heard > SERVER_TIMEOUT) {
+      clients[i].port = 0;
+      if (controller == &clients[i])
+        controller = NULL;
+    }
+  }
+}
+
+int serverInputs(TickInput inputs[SERVER_CATCH_UP]) {
+  Client *first = NULL;
+  int n = 0;
+  int i;
+
+  for (i = 0; i < SERVER_CLIENTS; i++)
+    if (clients[i].port && (!first || clients[i].joined < first->joined))
+      first = &clients[i];
+  if (first != controller && first)
+    first->input = first->newestInput ? first->newestInput - 1 : 0;
+  controller = first;
+  if (!first)
+    return 0;
+
+  /* bounded latency before every input: past the backlog they are dropped */
+  while ((Sint32)(first->newestInput - first->input) > INPUT_BACKLOG) {
+    first->input++;
+    statDropped++;
+  }
+  while (n < SERVER_CATCH_UP) {
+    int slot = (int)((first->input + 1) & (INPUTS - 1));
+    if (first->inputNumbers[slot] != first->input + 1)
+      break;
+    inputs[n++] = first->inputs[slot];
+    first->input++;
+  }
+  if (n == 0)
+    statLate++;
+  else if (n > 1)
+    statCaughtUp++;
+  return n;
+}
+
+static int compareCandidates(const void *a, const void *b) {
+  Uint32 x = *(const Uint32 *)a, y = *(const Uint32 *)b;
+  return x < y ? -1 : x > y;
+}
+
+/*
+ * The bullets around the client's view it lacks, each with another tick's
+ * worth of priority; highest first, with the count per pool in waiting.
+ * A record unacknowledged for longer than the round trip counts as lost
+ * and starts waiting again.
+ */
+static int collect(Client *c, int waiting[REPL_POOLS]) {
+  Real screenLeft = realFromInt(c->view);
+  Real screenRight = realFromInt(c->view + SERVER_VIEW_W);
+  Real screenBottom = realFromInt(SERVER_VIEW_H);
+  int n = 0;
+  int p, i;
+
+  for (p = 0; p < REPL_POOLS; p++) {
+    Uint16 *state = c->state + p * REPL_SERIALS;
+    int found = gridQuery(&grids[p], c->view - SERVER_MARGIN, -SERVER_MARGIN,
+                          c->view + SERVER_VIEW_W + SERVER_MARGIN,
+                          SERVER_VIEW_H + SERVER_MARGIN, relevant);
+
+    c->considered += (unsigned long)found;
+    waiting[p] = 0;
+    for (i = 0; i < found; i++) {
+      const GridItem *b = &grids[p].items[relevant[i]];
+      Uint16 *s = &state[b->serial];
+      int onScreen, priority;
+
+      if (*s & STATE_HELD)
+        continue;
+      if (*s & STATE_SENT) {
+        if ((int)((now - *s) & STATE_TICK) <= c->roundTrip + RESEND_MARGIN)
+          continue;
+        *s = 0;
+        c->lost++;
+      }
+      onScreen = b->x >= screenLeft && b->x < screenRight && b->y >= 0 &&
+                 b->y < screenBottom;
+      priority = SDL_min((*s & STATE_TICK) +
+                             (onScreen ? PRIORITY_SCREEN : PRIORITY_MARGIN),
+                         STATE_TICK);
+      *s = (Uint16)priority;
+      candidates[n++] = (Uint32)(STATE_TICK - priority) << 16 |
+                        (Uint32)p << 12 | b->index;
+      waiting[p]++;
+    }
+  }
+  if (n > 1)
+    SDL_qsort(candidates, (size_t)n, sizeof(candidates[0]), compareCandidates);
+  return n;
+}
+
+static void sendSnapshot(Client *c, const ReplActor actors[REPL_ACTORS],
+                         const ReplOwner *man,
+                         BulletPool *const pools[REPL_POOLS]) {
+  BitWriter w;
+  ReplActor zero[REPL_ACTORS];
+  const ReplActor *base = zero;
+  int slot = (int)(now & (REPL_HISTORY - 1));
+  int waiting[REPL_POOLS];
+  int p, i, n, take, bytes;
+  Uint64 start;
+
+  memset(zero, 0, sizeof(zero));
+  bitsWriterInit(&w, packet, budget);
+  bitsWrite(&w, now, 32);
+  if (c->acked != REPL_NO_TICK && c->acked != now &&
+      now - c->acked < REPL_HISTORY &&
+      c->sentTicks[c->acked & (REPL_HISTORY - 1)] == c->acked) {
+    bitsWrite(&w, 1, 1);
+    bitsWriteGamma(&w, now - c->acked);
+    base = c->sentActors[c->acked & (REPL_HISTORY - 1)];
+  } else {
+    bitsWrite(&w, 0, 1);
+    c->fullActors++;
+  }
+  for (i = 0; i < REPL_ACTORS; i++)
+    replWriteActor(&w, &actors[i], &base[i]);
+  bitsWrite(&w, c == controller, 1);
+  if (c == controller) {
+    ReplOwner owner = *man;
+    owner.input = c->input;
+    replWriteOwner(&w, &owner);
+  }
+
+  c->sentTicks[slot] = now;
+  c->sentCount[slot] = 0;
+  memcpy(c->sentActors[slot], actors, sizeof(c->sentActors[slot]));
+
+  /*
+   * The most pressing, as many as could possibly fit, go out in pool and
+   * serial order so each record codes small against the one before.
+   */
+  n = collect(c, waiting);
+  take = (bitsLeft(&w) - REPL_POOLS * (REPL_COUNT_BITS + 1)) / RECORD_BITS_MIN;
+  take = SDL_max(0, SDL_min(take, SDL_min(n, REPL_RECORDS_MAX)));
+  for (i = 0; i < take; i++) {
+    Uint32 index = candidates[i] & 0xfff;
+    p = (int)(candidates[i] >> 12 & 3);
+    candidates[i] =
+        (Uint32)p << 28 |
+        (Uint32)(Uint16)(pools[p]->items[index].serial - pools[p]->nextSerial)
+            << 12 |
+        index;
+  }
+  if (take > 1)
+    SDL_qsort(candidates, (size_t)take, sizeof(candidates[0]),
+              compareCandidates);
+
+  i = 0;
+  for (p = 0; p < REPL_POOLS; p++) {
+    const BulletPool *pool = pools[p];
+    /* room for the end of this pool and the pools still to come */
+    int reserve = (REPL_POOLS - p) * (REPL_COUNT_BITS + 1);
+    ReplRecord prev, rec;
+
+    memset(&prev, 0, sizeof(prev));
+    for (; i < take && (int)(candidates[i] >> 28) == p; i++) {
+      const Bullet *b = &pool->items[candidates[i] & 0xfff];
+      Uint16 *state = &c->state[p * REPL_SERIALS + b->serial];
+
+      if (bitsLeft(&w) < REPL_RECORD_BITS + reserve)
+        continue;
+      bitsWrite(&w, 1, 1);
+      replRecordFromBullet(&rec, b);
+      replWriteRecord(&w, &rec, &prev);
+      *state = (Uint16)(STATE_SENT | (now & STATE_TICK));
+      c->sent[slot][c->sentCount[slot]++] =
+          (Uint32)p * REPL_SERIALS + b->serial;
+      c->records++;
+      waiting[p]--;
+    }
+    bitsWrite(&w, 0, 1);
+    bitsWrite(&w, (Uint32)waiting[p], REPL_COUNT_BITS);
+    c->waiting += (unsigned long)waiting[p];
+  }
+
+  bytes = bitsBytes(&w);
+  start = SDL_GetPerformanceCounter();
+  netSendTo(&serverLink, c->port, packet, bytes);
+  statSendUs += (double)(SDL_GetPerformanceCounter() - start) * 1e6 /
+                (double)SDL_GetPerformanceFrequency();
+  c->packets++;
+  c->bytes += (unsigned long)bytes;
+  if (bytes > c->maxBytes)
+    c->maxBytes = bytes;
+}
+
+void serverBroadcast(Uint32 tick, const ReplActor actors[REPL_ACTORS],
+                     const ReplOwner *man,
+                     BulletPool *const pools[REPL_POOLS]) {
+  Uint64 start = SDL_GetPerformanceCounter();
+  double us;
+  int p, i;
+
+  now = tick;
+
+  /* serials handed out since the last tick are new bullets, nobody has them */
+  for (p = 0; p < REPL_POOLS; p++) {
+    Uint16 s;
+    if (broadcasting)
+      for (s = nextSerial[p]; s != pools[p]->nextSerial; s++)
+        for (i = 0; i < SERVER_CLIENTS; i++)
+          if (clients[i].port)
+            clients[i].state[p * REPL_SERIALS + s] = 0;
+    nextSerial[p] = pools[p]->nextSerial;
+    statBullets += (unsigned long)pools[p]->count;
+    gridBuild(&grids[p], pools[p]);
+  }
+  broadcasting = 1;
+
+  for (i = 0; i < SERVER_CLIENTS; i++)
+    if (clients[i].port)
+      sendSnapshot(&clients[i], actors, man, pools);
+
+  us = (double)(SDL_GetPerformanceCounter() - start) * 1e6 /
+       (double)SDL_GetPerformanceFrequency();
+  statUs += us;
+  if (us > statWorstUs)
+    statWorstUs = us;
+  statTicks++;
+}
+
+int serverClientCount(void) {
+  int n = 0;
+  int i;
+
+  for (i = 0; i < SERVER_CLIENTS; i++)
+    n += clients[i].port != 0;
+  return n;
+}
+
+void serverPrintStats(void) {
+  unsigned long packets = 0, bytes = 0, fullActors = 0, records = 0, lost = 0;
+  unsigned long considered = 0, waiting = 0;
+  int maxBytes = 0;
+  int i;
+
+  if (statTicks == 0)
+    return;
+  for (i = 0; i < SERVER_CLIENTS; i++) {
+    const Client *c = &clients[i];
+    packets += c->packets;
+    bytes += c->bytes;
+    fullActors += c->fullActors;
+    records += c->records;
+    lost += c->lost;
+    considered += c->considered;
+    waiting += c->waiting;
+    if (c->maxBytes > maxBytes)
+      maxBytes = c->maxBytes;
+  }
+  printf("server: %d clients, %lu ticks, %lu bullets a tick\n",
+         serverClientCount(), statTicks, statBullets / statTicks);
+  if (packets > 0) {
+    printf("server: %.1f bytes a tick per client (%d max), %lu records "
+           "(%lu lost), %lu without a baseline\n",
+           (double)bytes / (double)packets, maxBytes, records, lost,
+           fullActors);
+    printf("server: per client a tick %.1f bullets in view, %.2f sent, "
+           "%.2f left waiting\n",
+           (double)considered / (double)packets,
+           (double)records / (double)packets,
+           (double)waiting / (double)packets);
+  }
+  printf("server: the controlling client's input late on %lu ticks, caught "
+         "up on %lu, %lu inputs dropped\n",
+         statLate, statCaughtUp, statDropped);
+  printf("server: snapshots %.1f us a tick (%.1f worst), %.1f of it sending\n",
+         statUs / (double)statTicks, statWorstUs,
+         statSendUs / (double)statTicks);
+}
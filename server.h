@@ -0,0 +1,64 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "net.h"
+#include "replicate.h"
+
+/*
+ * The authoritative end of client/server play. The server runs the game
+ * and every tick sends each client a snapshot in the format described in
+ * replicate.h, delta coded against what that client has acknowledged.
+ * Clients join by sending their first acknowledgement and are dropped
+ * after SERVER_TIMEOUT of silence; the earliest one still connected
+ * controls the man.
+ *
+ * The man takes the controlling client's inputs in the order it numbered
+ * them, one a tick. When one is late he waits for it, and takes two a tick
+ * after, so he goes through exactly the steps the client predicted; only
+ * inputs further behind than the backlog allows are dropped.
+ *
+ * For each client the server remembers, per bullet, whether the client
+ * holds it, or which tick its record went out on, so a record is sent
+ * again only if no acknowledgement came back within the round trip.
+ *
+ * Only bullets around a client's view are relevant to it, found through a
+ * grid of every pool built once a tick. A relevant bullet the client lacks
+ * gains priority every tick it waits, more on screen than in the margin,
+ * and each snapshot carries the highest priorities that fit the budget.
+ * Under a tight budget the view fills in over a few ticks instead of
+ * some bullets never arriving.
+ */
+
+#define SERVER_CLIENTS 64
+#define SERVER_BUDGET 1200  /* default bytes of snapshot per client and tick */
+#define SERVER_TIMEOUT 3000 /* ms */
+#define SERVER_VIEW_W 320   /* a client's screen, pixels */
+#define SERVER_VIEW_H 240
+#define SERVER_MARGIN 128 /* around the screen, for what is about to show */
+#define SERVER_CATCH_UP 2 /* inputs the man takes in a tick at most */
+
+/* budget in bytes, up to NET_PACKET_MAX */
+int serverOpen(Uint16 port, const NetConditions *conditions, int budget);
+void serverClose(void);
+
+/* acknowledgements and input from the clients */
+void serverPoll(void);
+
+/*
+ * The controlling client's inputs for the tick, oldest first, returns how
+ * many: none without clients or while the next one is late.
+ */
+int serverInputs(TickInput inputs[SERVER_CATCH_UP]);
+
+/*
+ * A snapshot of the tick to every client, the controlling one also gets
+ * the man exactly; the input it was predicted from is filled in here.
+ */
+void serverBroadcast(Uint32 tick, const ReplActor actors[REPL_ACTORS],
+                     const ReplOwner *man,
+                     BulletPool *const pools[REPL_POOLS]);
+
+int serverClientCount(void);
+void serverPrintStats(void);
+
+#endif
@@ -0,0 +1,91 @@
+#include "snapshot.h"
+#include "assetpack.h"
+#include <string.h>
+
+void snapshotBegin(Snapshot *snap, Uint32 tick) {
+  snap->tick = tick;
+  snap->size = 0;
+}
+
+void snapshotPut(Snapshot *snap, const void *data, size_t n) {
+  /* SNAPSHOT_MAX covers everything the game writes, a miss is a bug */
+  SDL_assert(snap->size + n <= SNAPSHOT_MAX);
+  if (snap->size + n > SNAPSHOT_MAX)
+    return;
+  memcpy(snap->data + snap->size, data, n);
+  snap->size += (Uint32)n;
+}
+
+void snapshotPutPool(Snapshot *snap, const BulletPool *pool) {
+  snapshotPut(snap, &pool->count, sizeof(pool->count));
+  snapshotPut(snap, &pool->nextSerial, sizeof(pool->nextSerial));
+  snapshotPut(snap, pool->items, sizeof(Bullet) * (size_t)pool->count);
+}
+
+int snapshotGet(const Snapshot *snap, size_t *pos, void *data, size_t n) {
+  if (*pos + n > snap->size)
+    return -1;
+  memcpy(data, snap->data + *pos, n);
+  *pos += n;
+  return 0;
+}
+
+int snapshotGetPool(const Snapshot *snap, size_t *pos, BulletPool *pool) {
+  int count;
+
+  if (snapshotGet(snap, pos, &count, sizeof(count)) != 0 || count < 0 ||
+      count > BULLET_POOL_MAX ||
+      snapshotGet(snap, pos, &pool->nextSerial, sizeof(pool->nextSerial)) !=
+          0)
+    return -1;
+  if (snapshotGet(snap, pos, pool->items, sizeof(Bullet) * (size_t)count) !=
+      0)
+    return -1;
+  pool->count = count;
+  return 0;
+}
+
+Uint32 snapshotHash(const Snapshot *snap) {
+  Uint32 hash = assetHashBytes(ASSET_HASH_BASIS, &snap->tick,
+                               sizeof(snap->tick));
+  return assetHashBytes(hash, snap->data, snap->size);
+}
+
+int snapshotWrite(const Snapshot *snap, const char *path) {
+  SDL_RWops *rw = SDL_RWFromFile(path, "wb");
+  Uint32 header[4];
+  int ok = 1;
+
+  if (!rw)
+    return -1;
+  header[0] = SNAPSHOT_VERSION;
+  header[1] = sizeof(Real);
+  header[2] = snap->tick;
+  header[3] = snap->size;
+  ok &= SDL_RWwrite(rw, "CSNP", 4, 1) == 1;
+  ok &= SDL_RWwrite(rw, header, sizeof(header), 1) == 1;
+  ok &= snap->size == 0 || SDL_RWwrite(rw, snap->data, snap->size, 1) == 1;
+  ok &= SDL_RWclose(rw) == 0;
+  return ok ? 0 : -1;
+}
+
+int snapshotRead(Snapshot *snap, const char *path) {
+  SDL_RWops *rw = SDL_RWFromFile(path, "rb");
+  Uint32 header[4];
+  char magic[4];
+  int ok;
+
+  if (!rw)
+    return -1;
+  ok = SDL_RWread(rw, magic, 4, 1) == 1 && memcmp(magic, "CSNP", 4) == 0 &&
+       SDL_RWread(rw, header, sizeof(header), 1) == 1 &&
+       header[0] == SNAPSHOT_VERSION && header[1] == sizeof(Real) &&
+       header[3] <= SNAPSHOT_MAX &&
+       (header[3] == 0 || SDL_RWread(rw, snap->data, header[3], 1) == 1);
+  SDL_RWclose(rw);
+  if (!ok)
+    return -1;
+  snap->tick = header[2];
+  snap->size = header[3];
+  return 0;
+}
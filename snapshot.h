@@ -0,0 +1,44 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "ai.h"
+#include "bullets.h"
+#include <SDL2/SDL.h>
+
+/*
+ * World snapshots: the simulation state packed into one flat buffer of
+ * plain values and IDs, no pointers, so saving and restoring are a handful
+ * of memcpy calls and a snapshot can be hashed, compared or written out
+ * as is. What goes in is up to the game, read back in the order it was
+ * written; bullet pools store only their live bullets.
+ *
+ * On disk, for quick-saves and bug reports, native byte order:
+ *
+ *   "CSNP" | version | sizeof(Real) | tick | size | data
+ *
+ * A snapshot only loads into a build with the same Real type.
+ */
+
+#define SNAPSHOT_VERSION 5
+#define SNAPSHOT_MAX (4096 + 3 * sizeof(BulletPool) + sizeof(Horde))
+
+typedef struct {
+  Uint32 tick;
+  Uint32 size; /* bytes of data in use */
+  Uint8 data[SNAPSHOT_MAX];
+} Snapshot;
+
+void snapshotBegin(Snapshot *snap, Uint32 tick);
+void snapshotPut(Snapshot *snap, const void *data, size_t n);
+void snapshotPutPool(Snapshot *snap, const BulletPool *pool);
+
+/* read from *pos and advance it, -1 when the snapshot ends early */
+int snapshotGet(const Snapshot *snap, size_t *pos, void *data, size_t n);
+int snapshotGetPool(const Snapshot *snap, size_t *pos, BulletPool *pool);
+
+Uint32 snapshotHash(const Snapshot *snap);
+
+int snapshotWrite(const Snapshot *snap, const char *path);
+int snapshotRead(Snapshot *snap, const char *path);
+
+#endif
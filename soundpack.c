@@ -0,0 +1,250 @@
+#include "soundpack.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define HEADER_SIZE 12
+#define ENTRY_SIZE (SOUNDPACK_NAME_LEN + 8)
+#define DATA_ALIGN 16
+
+static Uint32 readLE32(const Uint8 *p);
+static size_t alignUp(size_t n);
+static int validate(SoundPack *pack, const Uint8 *data, size_t size);
+static int readWhole(SoundPack *pack, const char *path);
+static size_t clipBytes(const SoundClip *clip);
+#ifdef __linux__
+static void touchPages(SoundPack *pack);
+#endif
+
+static Uint32 readLE32(const Uint8 *p) {
+  return (Uint32)p[0] | (Uint32)p[1] << 8 | (Uint32)p[2] << 16 |
+         (Uint32)p[3] << 24;
+}
+
+static size_t alignUp(size_t n) {
+  return (n + DATA_ALIGN - 1) & ~(size_t)(DATA_ALIGN - 1);
+}
+
+/* the samples and the silence after them */
+static size_t clipBytes(const SoundClip *clip) {
+  return ((size_t)clip->frames + SOUNDPACK_TAIL) * 2;
+}
+
+/* checked once here so soundPackGet() can trust every entry */
+static int validate(SoundPack *pack, const Uint8 *data, size_t size) {
+  Uint32 count;
+  Uint32 i;
+
+  if (size < HEADER_SIZE || memcmp(data, "CSND", 4) != 0 ||
+      readLE32(data + 4) != SOUNDPACK_VERSION)
+    return -1;
+  count = readLE32(data + 8);
+  if ((size - HEADER_SIZE) / ENTRY_SIZE < count)
+    return -1;
+
+  for (i = 0; i < count; i++) {
+    const Uint8 *e = data + HEADER_SIZE + i * ENTRY_SIZE;
+    size_t frames = readLE32(e + SOUNDPACK_NAME_LEN);
+    size_t offset = readLE32(e + SOUNDPACK_NAME_LEN + 4);
+
+    if (e[SOUNDPACK_NAME_LEN - 1] != '\0' || offset % DATA_ALIGN != 0 ||
+        offset > size || (size - offset) / 2 < frames + SOUNDPACK_TAIL)
+      return -1;
+  }
+
+  pack->data = data;
+  pack->size = size;
+  pack->count = count;
+  return 0;
+}
+
+#ifdef __linux__
+/* faults every page in now, the audio callback must never wait on disk */
+static void touchPages(SoundPack *pack) {
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  size_t at;
+
+  for (at = 0; at < pack->size; at += page)
+    pack->touched += pack->data[at];
+}
+#endif
+
+/* one allocation, where there is no mapping */
+static int readWhole(SoundPack *pack, const char *path) {
+  SDL_RWops *rw = SDL_RWFromFile(path, "rb");
+  Sint64 size;
+  Uint8 *buf;
+
+  if (!rw)
+    return -1;
+  size = SDL_RWsize(rw);
+  if (size <= 0) {
+    SDL_RWclose(rw);
+    return -1;
+  }
+  buf = (Uint8 *)malloc((size_t)size);
+  if (!buf || SDL_RWread(rw, buf, (size_t)size, 1) != 1) {
+    free(buf);
+    SDL_RWclose(rw);
+    return -1;
+  }
+  SDL_RWclose(rw);
+
+  if (validate(pack, buf, (size_t)size) != 0) {
+    free(buf);
+    return -1;
+  }
+  pack->owned = buf;
+  return 0;
+}
+
+int soundPackOpen(SoundPack *pack, const char *path) {
+#ifdef __linux__
+  struct stat st;
+  void *map;
+  int fd;
+#endif
+
+  memset(pack, 0, sizeof(*pack));
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+  printf("%s holds little endian samples\n", path);
+  return -1;
+#endif
+
+#ifdef __linux__
+  fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return -1;
+  if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+    close(fd);
+    return -1;
+  }
+  map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd); /* the mapping keeps the file */
+  if (map == MAP_FAILED)
+    return readWhole(pack, path);
+  if (validate(pack, (const Uint8 *)map, (size_t)st.st_size) != 0) {
+    munmap(map, (size_t)st.st_size);
+    memset(pack, 0, sizeof(*pack));
+    return -1;
+  }
+  pack->mapped = map;
+  touchPages(pack);
+  return 0;
+#else
+  return readWhole(pack, path);
+#endif
+}
+
+void soundPackClose(SoundPack *pack) {
+#ifdef __linux__
+  if (pack->mapped)
+    munmap(pack->mapped, pack->size);
+#endif
+  free(pack->owned);
+  memset(pack, 0, sizeof(*pack));
+}
+
+int soundPackGet(const SoundPack *pack, int id, SoundClip *clip) {
+  const Uint8 *e;
+  const Uint8 *samples;
+
+  if (id < 0 || (Uint32)id >= pack->count)
+    return 0;
+  e = pack->data + HEADER_SIZE + (size_t)id * ENTRY_SIZE;
+  samples = pack->data + readLE32(e + SOUNDPACK_NAME_LEN + 4);
+  clip->name = (const char *)e;
+  clip->frames = (int)readLE32(e + SOUNDPACK_NAME_LEN);
+  clip->samples = (const Sint16 *)(const void *)samples;
+  return 1;
+}
+
+int soundPackWrite(const char *path, const SoundClip *clips, int count) {
+  static const Uint8 zeros[SOUNDPACK_TAIL * 2 + DATA_ALIGN] = {0};
+  SDL_RWops *rw = SDL_RWFromFile(path, "wb");
+  size_t offset;
+  size_t written;
+  int ok = 1;
+  int i, f;
+
+  if (!rw)
+    return -1;
+
+  ok &= SDL_RWwrite(rw, "CSND", 4, 1) == 1;
+  ok &= SDL_WriteLE32(rw, SOUNDPACK_VERSION) == 1;
+  ok &= SDL_WriteLE32(rw, (Uint32)count) == 1;
+
+  offset = alignUp(HEADER_SIZE + (size_t)count * ENTRY_SIZE);
+  for (i = 0; i < count; i++) {
+    char name[SOUNDPACK_NAME_LEN];
+
+    memset(name, 0, sizeof(name));
+    SDL_strlcpy(name, clips[i].name, sizeof(name));
+    ok &= SDL_RWwrite(rw, name, sizeof(name), 1) == 1;
+    ok &= SDL_WriteLE32(rw, (Uint32)clips[i].frames) == 1;
+    ok &= SDL_WriteLE32(rw, (Uint32)offset) == 1;
+    offset = alignUp(offset + clipBytes(&clips[i]));
+  }
+
+  written = HEADER_SIZE + (size_t)count * ENTRY_SIZE;
+  for (i = 0; i < count; i++) {
+    size_t pad = alignUp(written) - written;
+
+    ok &= SDL_RWwrite(rw, zeros, 1, pad) == pad;
+    for (f = 0; f < clips[i].frames; f++)
+      ok &= SDL_WriteLE16(rw, (Uint16)clips[i].samples[f]) == 1;
+    ok &= SDL_RWwrite(rw, zeros, 2, SOUNDPACK_TAIL) == SOUNDPACK_TAIL;
+    written = alignUp(written) + clipBytes(&clips[i]);
+  }
+
+  SDL_RWclose(rw);
+  if (!ok) {
+    printf("Cannot write %s\n", path);
+    return -1;
+  }
+  return 0;
+}
+
+int soundLoadWav(const char *path, Sint16 **samples, int *frames) {
+  SDL_AudioSpec spec;
+  Uint8 *buf;
+  Uint32 len;
+  const Sint16 *in;
+  Sint16 *out;
+  int channels, i;
+
+  if (!SDL_LoadWAV(path, &spec, &buf, &len)) {
+    printf("Cannot load %s: %s\n", path, SDL_GetError());
+    return -1;
+  }
+  channels = spec.channels;
+  if (spec.format != AUDIO_S16SYS || spec.freq != SOUNDPACK_RATE ||
+      channels < 1 || channels > 2) {
+    printf("%s is not 16-bit mono or stereo at %d Hz\n", path,
+           SOUNDPACK_RATE);
+    SDL_FreeWAV(buf);
+    return -1;
+  }
+
+  *frames = (int)(len / (Uint32)(2 * channels));
+  out = (Sint16 *)malloc((size_t)*frames * sizeof(Sint16));
+  if (*frames == 0 || !out) {
+    free(out);
+    SDL_FreeWAV(buf);
+    return -1;
+  }
+  in = (const Sint16 *)(const void *)buf;
+  for (i = 0; i < *frames; i++)
+    out[i] = channels == 1 ? in[i]
+                           : (Sint16)(((Sint32)in[2 * i] + in[2 * i + 1]) / 2);
+  SDL_FreeWAV(buf);
+  *samples = out;
+  return 0;
+}
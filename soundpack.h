@@ -0,0 +1,59 @@
+#ifndef SOUNDPACK_H
+#define SOUNDPACK_H
+
+#include <SDL2/SDL.h>
+
+/*
+ * Cooked sound pack: sound effects decoded at build time to the mixer's own
+ * format, mono 16-bit little endian at SOUNDPACK_RATE, so playing one is a
+ * pointer into the pack. Layout, all little endian:
+ *
+ *   "CSND" | version | count | count * entry | samples
+ *   entry: name[SOUNDPACK_NAME_LEN] | frames | data offset
+ *
+ * Entries are in SOUND_* order, a sound is referenced by its ID. Each
+ * sound starts on a 16 byte boundary and is followed by SOUNDPACK_TAIL
+ * frames of silence, mixers may read that far past the end.
+ *
+ * The file is mapped read-only where the platform can, with its pages read
+ * in up front so no play ever waits on the disk; elsewhere it is read into
+ * one allocation. Either way nothing is allocated or decoded after
+ * soundPackOpen().
+ */
+
+#define SOUNDPACK_VERSION 1
+#define SOUNDPACK_RATE 44100
+#define SOUNDPACK_NAME_LEN 16
+#define SOUNDPACK_TAIL 16
+
+typedef struct {
+  const char *name;
+  const Sint16 *samples;
+  int frames;
+} SoundClip;
+
+typedef struct {
+  const Uint8 *data;
+  size_t size;
+  Uint32 count;
+  void *mapped; /* the mapping, NULL when read into owned */
+  Uint8 *owned;
+  Uint32 touched; /* sum of a byte a page, reading them in */
+} SoundPack;
+
+int soundPackOpen(SoundPack *pack, const char *path);
+void soundPackClose(SoundPack *pack);
+
+/* returns 1 and fills clip if the pack has sound id, 0 otherwise */
+int soundPackGet(const SoundPack *pack, int id, SoundClip *clip);
+
+/* clips in SOUND_* order, see audio.h */
+int soundPackWrite(const char *path, const SoundClip *clips, int count);
+
+/*
+ * Decodes a 16-bit WAV at SOUNDPACK_RATE to mono, what cooking does for each
+ * sound. samples is malloc'd, the caller frees it. -1 on anything else.
+ */
+int soundLoadWav(const char *path, Sint16 **samples, int *frames);
+
+#endif
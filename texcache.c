@@ -0,0 +1,336 @@
+#include "texcache.h"
+#include <SDL2/SDL_image.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int findKey(const TexCache *cache, const char *path, Uint32 pathHash);
+static int newKey(TexCache *cache);
+static int keysOnSlot(const TexCache *cache, int slot);
+static void evictSlot(TexCache *cache, int slot);
+static void makeRoom(TexCache *cache, size_t bytes);
+static int samePixels(const TexSlot *s, const void *pixels, int w, int h,
+                      int pitch);
+static void keepPixels(TexSlot *s, const void *pixels, int pitch);
+static int bindPixels(TexCache *cache, const void *pixels, int w, int h,
+                      int pitch, Uint32 contentHash);
+
+static int findKey(const TexCache *cache, const char *path, Uint32 pathHash) {
+  int i;
+  for (i = 0; i < TEXCACHE_MAX_KEYS; i++) {
+    const TexKey *key = &cache->keys[i];
+    if (key->slot >= 0 && key->pathHash == pathHash &&
+        strcmp(key->path, path) == 0)
+      return i;
+  }
+  return -1;
+}
+
+/* a free key, or the stalest one nobody holds; -1 if every path is in use */
+static int newKey(TexCache *cache) {
+  int i;
+  int victim = -1;
+
+  for (i = 0; i < TEXCACHE_MAX_KEYS; i++)
+    if (cache->keys[i].slot < 0)
+      return i;
+
+  for (i = 0; i < TEXCACHE_MAX_KEYS; i++) {
+    const TexKey *key = &cache->keys[i];
+    if (key->refs == 0 &&
+        (victim < 0 || cache->slots[key->slot].lastUse <
+                           cache->slots[cache->keys[victim].slot].lastUse))
+      victim = i;
+  }
+  if (victim >= 0)
+    cache->keys[victim].slot = -1;
+  return victim;
+}
+
+static int keysOnSlot(const TexCache *cache, int slot) {
+  int i;
+  int n = 0;
+  for (i = 0; i < TEXCACHE_MAX_KEYS; i++)
+    if (cache->keys[i].slot == slot)
+      n++;
+  return n;
+}
+
+static void evictSlot(TexCache *cache, int slot) {
+  TexSlot *s = &cache->slots[slot];
+  int i;
+
+  for (i = 0; i < TEXCACHE_MAX_KEYS; i++)
+    if (cache->keys[i].slot == slot)
+      cache->keys[i].slot = -1;
+
+  SDL_DestroyTexture(s->texture);
+  free(s->pixels);
+  cache->used -= s->bytes;
+  memset(s, 0, sizeof(*s));
+  cache->evictions++;
+}
+
+/* drops unreferenced slots, least recently used first, until bytes fit */
+static void makeRoom(TexCache *cache, size_t bytes) {
+  while (cache->used + bytes > cache->budget) {
+    int i;
+    int victim = -1;
+
+    for (i = 0; i < TEXCACHE_MAX_SLOTS; i++) {
+      const TexSlot *s = &cache->slots[i];
+      if (s->texture && s->refs == 0 &&
+          (victim < 0 || s->lastUse < cache->slots[victim].lastUse))
+        victim = i;
+    }
+
+    /* everything left is in use; going over budget beats failing a load */
+    if (victim < 0)
+      break;
+    evictSlot(cache, victim);
+  }
+}
+
+/* byte for byte, after the hashes matched */
+static int samePixels(const TexSlot *s, const void *pixels, int w, int h,
+                      int pitch) {
+  const Uint8 *row = (const Uint8 *)pixels;
+  size_t rowBytes = (size_t)w * 4;
+  int y;
+
+  if (s->w != w || s->h != h)
+    return 0;
+  for (y = 0; y < h; y++, row += pitch)
+    if (memcmp(s->pixels + (size_t)y * rowBytes, row, rowBytes) != 0)
+      return 0;
+  return 1;
+}
+
+/* into the slot's copy, which is already w * h * 4 bytes */
+static void keepPixels(TexSlot *s, const void *pixels, int pitch) {
+  const Uint8 *row = (const Uint8 *)pixels;
+  size_t rowBytes = (size_t)s->w * 4;
+  int y;
+
+  for (y = 0; y < s->h; y++, row += pitch)
+    memcpy(s->pixels + (size_t)y * rowBytes, row, rowBytes);
+}
+
+/*
+ * Finds the slot already holding these pixels or uploads them into a new
+ * one. Reference counts are left to the caller.
+ */
+static int bindPixels(TexCache *cache, const void *pixels, int w, int h,
+                      int pitch, Uint32 contentHash) {
+  size_t bytes = (size_t)w * (size_t)h * 4;
+  TexSlot *s;
+  int i;
+  int slot = -1;
+
+  for (i = 0; i < TEXCACHE_MAX_SLOTS; i++) {
+    s = &cache->slots[i];
+    if (s->texture && s->contentHash == contentHash &&
+        samePixels(s, pixels, w, h, pitch)) {
+      cache->dedups++;
+      return i;
+    }
+  }
+
+  makeRoom(cache, bytes);
+  for (i = 0; i < TEXCACHE_MAX_SLOTS; i++) {
+    if (!cache->slots[i].texture) {
+      slot = i;
+      break;
+    }
+  }
+  if (slot < 0) {
+    printf("Texture cache is full (%d slots)\n", TEXCACHE_MAX_SLOTS);
+    return -1;
+  }
+
+  s = &cache->slots[slot];
+  s->pixels = (Uint8 *)malloc(bytes);
+  if (!s->pixels)
+    return -1;
+  s->texture = SDL_CreateTexture(cache->renderer, SDL_PIXELFORMAT_RGBA32,
+                                 SDL_TEXTUREACCESS_STATIC, w, h);
+  if (!s->texture) {
+    free(s->pixels);
+    s->pixels = NULL;
+    return -1;
+  }
+  SDL_UpdateTexture(s->texture, NULL, pixels, pitch);
+  SDL_SetTextureBlendMode(s->texture, SDL_BLENDMODE_BLEND);
+
+  s->contentHash = contentHash;
+  s->w = w;
+  s->h = h;
+  keepPixels(s, pixels, pitch);
+  s->bytes = bytes;
+  s->refs = 0;
+  s->lastUse = ++cache->clock;
+  cache->used += bytes;
+  return slot;
+}
+
+void texCacheInit(TexCache *cache, SDL_Renderer *renderer, size_t budget) {
+  int i;
+
+  memset(cache, 0, sizeof(*cache));
+  cache->renderer = renderer;
+  cache->budget = budget;
+  for (i = 0; i < TEXCACHE_MAX_KEYS; i++)
+    cache->keys[i].slot = -1;
+}
+
+void texCacheUsePack(TexCache *cache, const AssetPack *pack) {
+  cache->pack = pack;
+}
+
+void texCacheDestroy(TexCache *cache) {
+  int i;
+  for (i = 0; i < TEXCACHE_MAX_SLOTS; i++) {
+    if (cache->slots[i].texture)
+      SDL_DestroyTexture(cache->slots[i].texture);
+    free(cache->slots[i].pixels);
+  }
+  memset(cache->slots, 0, sizeof(cache->slots));
+  for (i = 0; i < TEXCACHE_MAX_KEYS; i++)
+    cache->keys[i].slot = -1;
+  cache->used = 0;
+}
+
+int texCacheAcquire(TexCache *cache, const char *path) {
+  Uint32 pathHash = assetHashBytes(ASSET_HASH_BASIS, path, strlen(path));
+  SDL_Surface *loaded;
+  SDL_Surface *rgba;
+  AssetImage image;
+  TexKey *key;
+  int handle;
+  int slot;
+
+  handle = findKey(cache, path, pathHash);
+  if (handle >= 0) {
+    key = &cache->keys[handle];
+    cache->hits++;
+    key->refs++;
+    cache->slots[key->slot].refs++;
+    cache->slots[key->slot].lastUse = ++cache->clock;
+    return handle;
+  }
+
+  cache->misses++;
+  handle = newKey(cache);
+  if (handle < 0) {
+    printf("Texture cache has no free keys (%d)\n", TEXCACHE_MAX_KEYS);
+    return -1;
+  }
+
+  if (cache->pack && assetPackFind(cache->pack, path, &image)) {
+    /* cooked: already RGBA32 and hashed, straight to the GPU */
+    slot = bindPixels(cache, image.pixels, image.w, image.h, image.pitch,
+                      image.hash);
+  } else {
+    loaded = IMG_Load(path);
+    if (!loaded)
+      return -1;
+
+    /* one pixel layout for every texture keeps content hashes comparable */
+    rgba = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_RGBA32, 0);
+    SDL_FreeSurface(loaded);
+    if (!rgba)
+      return -1;
+
+    slot = bindPixels(cache, rgba->pixels, rgba->w, rgba->h, rgba->pitch,
+                      assetHashPixels(rgba->pixels, rgba->w, rgba->h,
+                                      rgba->pitch));
+    SDL_FreeSurface(rgba);
+  }
+  if (slot < 0)
+    return -1;
+
+  key = &cache->keys[handle];
+  strncpy(key->path, path, TEXCACHE_PATH_LEN - 1);
+  key->path[TEXCACHE_PATH_LEN - 1] = '\0';
+  key->pathHash = pathHash;
+  key->slot = slot;
+  key->refs = 1;
+  cache->slots[slot].refs++;
+  cache->slots[slot].lastUse = ++cache->clock;
+  return handle;
+}
+
+void texCacheRelease(TexCache *cache, int handle) {
+  TexKey *key;
+
+  if (handle < 0)
+    return;
+  key = &cache->keys[handle];
+  if (key->slot < 0 || key->refs <= 0)
+    return;
+  key->refs--;
+  cache->slots[key->slot].refs--;
+  cache->slots[key->slot].lastUse = ++cache->clock;
+}
+
+SDL_Texture *texCacheGet(const TexCache *cache, int handle) {
+  if (handle < 0 || cache->keys[handle].slot < 0)
+    return NULL;
+  return cache->slots[cache->keys[handle].slot].texture;
+}
+
+int texCacheReload(TexCache *cache, const char *path, const void *pixels,
+                   int w, int h, int pitch) {
+  Uint32 pathHash = assetHashBytes(ASSET_HASH_BASIS, path, strlen(path));
+  int handle = findKey(cache, path, pathHash);
+  Uint32 contentHash;
+  TexKey *key;
+  TexSlot *old;
+  int slot;
+
+  if (handle < 0)
+    return 0;
+  key = &cache->keys[handle];
+  old = &cache->slots[key->slot];
+
+  /* nobody holds it: drop the stale copy, the next acquire reads the file */
+  if (key->refs == 0) {
+    if (old->refs == 0)
+      evictSlot(cache, key->slot);
+    else
+      key->slot = -1;
+    return 0;
+  }
+
+  contentHash = assetHashPixels(pixels, w, h, pitch);
+  if (contentHash == old->contentHash && samePixels(old, pixels, w, h, pitch))
+    return 1;
+
+  /* sole owner of a same-sized texture: overwrite it in place */
+  if (keysOnSlot(cache, key->slot) == 1 && old->w == w && old->h == h) {
+    SDL_UpdateTexture(old->texture, NULL, pixels, pitch);
+    keepPixels(old, pixels, pitch);
+    old->contentHash = contentHash;
+    return 1;
+  }
+
+  slot = bindPixels(cache, pixels, w, h, pitch, contentHash);
+  if (slot < 0)
+    return 0;
+
+  old->refs -= key->refs;
+  cache->slots[slot].refs += key->refs;
+  cache->slots[slot].lastUse = ++cache->clock;
+  if (old->refs == 0 && keysOnSlot(cache, key->slot) == 1)
+    evictSlot(cache, key->slot);
+  key->slot = slot;
+  return 1;
+}
+
+void texCachePrintStats(const TexCache *cache) {
+  printf("textures: %lu hits, %lu misses, %lu dedups, %lu evictions, "
+         "%lu/%lu KiB\n",
+         cache->hits, cache->misses, cache->dedups, cache->evictions,
+         (unsigned long)(cache->used / 1024),
+         (unsigned long)(cache->budget / 1024));
+}
@@ -0,0 +1,67 @@
+#ifndef TEXCACHE_H
+#define TEXCACHE_H
+
+#include "assetpack.h"
+#include <SDL2/SDL.h>
+
+#define TEXCACHE_MAX_SLOTS 64
+#define TEXCACHE_MAX_KEYS 128
+#define TEXCACHE_PATH_LEN 64
+
+/*
+ * One GPU texture. Several asset paths may resolve to the same slot when
+ * their decoded pixels are the same, so the texture is uploaded only once.
+ * The content hash finds candidates and a CPU copy of the pixels confirms
+ * them, so a hash collision can't bind the wrong image. Slots that nobody
+ * references stay resident until the VRAM budget forces them out, least
+ * recently used first.
+ */
+typedef struct {
+  SDL_Texture *texture;
+  Uint32 contentHash;
+  Uint8 *pixels; /* what was uploaded, w * 4 bytes a row */
+  int w, h;
+  size_t bytes;
+  int refs;
+  Uint32 lastUse;
+} TexSlot;
+
+/* asset path -> slot, handles returned to callers index this table */
+typedef struct {
+  char path[TEXCACHE_PATH_LEN];
+  Uint32 pathHash;
+  int slot; /* -1 when the key is free */
+  int refs;
+} TexKey;
+
+typedef struct {
+  SDL_Renderer *renderer;
+  const AssetPack *pack; /* consulted before decoding from disk, may be NULL */
+  TexSlot slots[TEXCACHE_MAX_SLOTS];
+  TexKey keys[TEXCACHE_MAX_KEYS];
+  size_t budget; /* VRAM budget in bytes */
+  size_t used;
+  Uint32 clock;
+
+  unsigned long hits, misses, dedups, evictions;
+} TexCache;
+
+void texCacheInit(TexCache *cache, SDL_Renderer *renderer, size_t budget);
+void texCacheUsePack(TexCache *cache, const AssetPack *pack);
+void texCacheDestroy(TexCache *cache);
+
+/* returns a handle (>= 0) holding one reference, or -1 if the load failed */
+int texCacheAcquire(TexCache *cache, const char *path);
+void texCacheRelease(TexCache *cache, int handle);
+SDL_Texture *texCacheGet(const TexCache *cache, int handle);
+
+/*
+ * Replaces the pixels behind path with new RGBA32 data, keeping every handle
+ * to it valid. Returns 1 if the path was cached, 0 if nobody uses it.
+ */
+int texCacheReload(TexCache *cache, const char *path, const void *pixels,
+                   int w, int h, int pitch);
+
+void texCachePrintStats(const TexCache *cache);
+
+#endif
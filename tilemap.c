@@ -0,0 +1,480 @@
+#include "tilemap.h"
+#include "arena.h"
+#include <string.h>
+
+#define HEADER_SIZE 12
+#define TILEMAP_VERSION 1
+#define CHUNK_TILES (CHUNK_W * CHUNK_H)
+#define PACKED_MAX (CHUNK_TILES * 2) /* every run of length one */
+
+/* box edges are exclusive, keep them off tile lines */
+#ifdef FIXED_POINT
+#define EDGE 1
+#else
+#define EDGE 0.001f
+#endif
+
+/* generator shape, in tile rows from the top */
+#define GROUND_ROW 7
+#define GROUND_MIN 6
+#define GROUND_MAX 10
+#define FLAT_START 24 /* columns left flat for the spawn point */
+
+static const Uint8 tileColors[TILE_TYPES][3] = {
+    {0, 0, 0}, {120, 80, 40}, {60, 160, 50}, {130, 130, 140}};
+
+static int findChunk(const Tilemap *map, int index);
+static TileChunk *recycleChunk(Tilemap *map);
+static int loadChunk(Tilemap *map, TileChunk *chunk, int index);
+static int readChunk(const Tilemap *map, TileChunk *chunk, int index);
+static void buildSolidMasks(TileChunk *chunk);
+static int tileOf(Real v);
+static Uint32 bitRange(int lo, int hi);
+static Uint32 rowMask(const Tilemap *map, int chunk, int ty0, int ty1);
+static int firstSolidColumn(const Tilemap *map, int from, int to, int ty0,
+                            int ty1);
+static int lastSolidColumn(const Tilemap *map, int from, int to, int ty0,
+                           int ty1);
+static int rowSolid(const Tilemap *map, int ty, int tx0, int tx1);
+static size_t packChunk(const TileChunk *chunk, Uint8 *out);
+static Uint32 nextRandom(Uint32 *state);
+
+/* resident slot holding the chunk, -1 when it is not loaded */
+static int findChunk(const Tilemap *map, int index) {
+  int i;
+  for (i = 0; i < TILEMAP_RESIDENT; i++)
+    if (map->resident[i].index == index)
+      return i;
+  return -1;
+}
+
+/* a free slot, otherwise the one the camera left longest ago */
+static TileChunk *recycleChunk(Tilemap *map) {
+  TileChunk *oldest = &map->resident[0];
+  int i;
+
+  for (i = 0; i < TILEMAP_RESIDENT; i++) {
+    TileChunk *chunk = &map->resident[i];
+    if (chunk->index < 0)
+      return chunk;
+    if ((Sint32)(chunk->lastUse - oldest->lastUse) < 0)
+      oldest = chunk;
+  }
+  map->evictions++;
+  return oldest;
+}
+
+static int loadChunk(Tilemap *map, TileChunk *chunk, int index) {
+  map->loads++;
+  return readChunk(map, chunk, index);
+}
+
+/* decodes the chunk from the file, leaving the resident set alone */
+static int readChunk(const Tilemap *map, TileChunk *chunk, int index) {
+  Uint8 packed[PACKED_MAX];
+  Uint8 *tiles = &chunk->tiles[0][0];
+  Uint32 start, end;
+  size_t n = 0;
+  size_t i;
+
+  chunk->index = index;
+
+  if (SDL_RWseek(map->file, HEADER_SIZE + (Sint64)index * 4, RW_SEEK_SET) < 0)
+    goto fail;
+  start = SDL_ReadLE32(map->file);
+  end = SDL_ReadLE32(map->file);
+  if (end <= start || end - start > PACKED_MAX ||
+      SDL_RWseek(map->file, start, RW_SEEK_SET) < 0 ||
+      SDL_RWread(map->file, packed, end - start, 1) != 1)
+    goto fail;
+
+  /* (run length, tile) pairs, row by row */
+  for (i = 0; i + 1 < end - start; i += 2) {
+    size_t run = packed[i];
+    if (run == 0 || run > CHUNK_TILES - n || packed[i + 1] >= TILE_TYPES)
+      goto fail;
+    memset(tiles + n, packed[i + 1], run);
+    n += run;
+  }
+  if (n == CHUNK_TILES) {
+    buildSolidMasks(chunk);
+    return 0;
+  }
+
+fail:
+  /* keep the slot so a bad chunk is not read again every frame */
+  memset(chunk->tiles, TILE_EMPTY, sizeof(chunk->tiles));
+  buildSolidMasks(chunk);
+  return -1;
+}
+
+static void buildSolidMasks(TileChunk *chunk) {
+  int row, col;
+
+  for (row = 0; row < CHUNK_H; row++) {
+    Uint32 mask = 0;
+    for (col = 0; col < CHUNK_W; col++)
+      mask |= (Uint32)(chunk->tiles[row][col] != TILE_EMPTY) << col;
+    chunk->solid[row] = mask;
+  }
+}
+
+/* tile index of a coordinate, rounding down on both sides of zero */
+static int tileOf(Real v) {
+  int px = realToInt(v);
+  return px >= 0 ? px / TILE_SIZE : -((TILE_SIZE - 1 - px) / TILE_SIZE);
+}
+
+/* bits lo..hi inclusive, 0 <= lo <= hi < 32 */
+static Uint32 bitRange(int lo, int hi) {
+  return (0xFFFFFFFFu >> (31 - hi)) & (0xFFFFFFFFu << lo);
+}
+
+/* solid columns of the chunk in any of rows ty0..ty1 */
+static Uint32 rowMask(const Tilemap *map, int chunk, int ty0, int ty1) {
+  int slot = findChunk(map, chunk);
+  Uint32 mask = 0;
+  int ty;
+
+  if (slot < 0)
+    return 0;
+  for (ty = SDL_max(ty0, 0); ty <= SDL_min(ty1, CHUNK_H - 1); ty++)
+    mask |= map->resident[slot].solid[ty];
+  return mask;
+}
+
+/* lowest solid column in from..to across rows ty0..ty1, -1 for none */
+static int firstSolidColumn(const Tilemap *map, int from, int to, int ty0,
+                            int ty1) {
+  int chunk;
+
+  from = SDL_max(from, 0);
+  for (chunk = from / CHUNK_W; chunk <= to / CHUNK_W; chunk++) {
+    int lo = chunk == from / CHUNK_W ? from % CHUNK_W : 0;
+    int hi = chunk == to / CHUNK_W ? to % CHUNK_W : CHUNK_W - 1;
+    Uint32 mask = rowMask(map, chunk, ty0, ty1) & bitRange(lo, hi);
+    if (mask)
+      return chunk * CHUNK_W +
+             SDL_MostSignificantBitIndex32(mask & (~mask + 1));
+  }
+  return -1;
+}
+
+/* highest solid column in from..to across rows ty0..ty1, -1 for none */
+static int lastSolidColumn(const Tilemap *map, int from, int to, int ty0,
+                           int ty1) {
+  int chunk;
+
+  if (to < 0)
+    return -1;
+  from = SDL_max(from, 0);
+  for (chunk = to / CHUNK_W; chunk >= from / CHUNK_W; chunk--) {
+    int lo = chunk == from / CHUNK_W ? from % CHUNK_W : 0;
+    int hi = chunk == to / CHUNK_W ? to % CHUNK_W : CHUNK_W - 1;
+    Uint32 mask = rowMask(map, chunk, ty0, ty1) & bitRange(lo, hi);
+    if (mask)
+      return chunk * CHUNK_W + SDL_MostSignificantBitIndex32(mask);
+  }
+  return -1;
+}
+
+/* whether any of columns tx0..tx1 is solid in row ty */
+static int rowSolid(const Tilemap *map, int ty, int tx0, int tx1) {
+  int chunk;
+
+  if (ty < 0 || ty >= CHUNK_H || tx1 < 0)
+    return 0;
+  tx0 = SDL_max(tx0, 0);
+  for (chunk = tx0 / CHUNK_W; chunk <= tx1 / CHUNK_W; chunk++) {
+    int lo = chunk == tx0 / CHUNK_W ? tx0 % CHUNK_W : 0;
+    int hi = chunk == tx1 / CHUNK_W ? tx1 % CHUNK_W : CHUNK_W - 1;
+    int slot = findChunk(map, chunk);
+    if (slot >= 0 && (map->resident[slot].solid[ty] & bitRange(lo, hi)))
+      return 1;
+  }
+  return 0;
+}
+
+static size_t packChunk(const TileChunk *chunk, Uint8 *out) {
+  const Uint8 *tiles = &chunk->tiles[0][0];
+  size_t size = 0;
+  int i = 0;
+
+  while (i < CHUNK_TILES) {
+    int run = 1;
+    while (i + run < CHUNK_TILES && run < 255 && tiles[i + run] == tiles[i])
+      run++;
+    out[size++] = (Uint8)run;
+    out[size++] = tiles[i];
+    i += run;
+  }
+  return size;
+}
+
+/* small LCG, levels must come out the same on every machine */
+static Uint32 nextRandom(Uint32 *state) {
+  *state = *state * 1664525u + 1013904223u;
+  return *state >> 16;
+}
+
+int tilemapOpen(Tilemap *map, const char *path) {
+  char magic[4];
+  int i;
+
+  memset(map, 0, sizeof(*map));
+  for (i = 0; i < TILEMAP_RESIDENT; i++)
+    map->resident[i].index = -1;
+
+  map->file = SDL_RWFromFile(path, "rb");
+  if (!map->file)
+    return -1;
+
+  if (SDL_RWread(map->file, magic, 4, 1) != 1 ||
+      memcmp(magic, "CLVL", 4) != 0 ||
+      SDL_ReadLE32(map->file) != TILEMAP_VERSION) {
+    tilemapClose(map);
+    return -1;
+  }
+  map->widthChunks = (int)SDL_ReadLE32(map->file);
+  if (map->widthChunks <= 0 || map->widthChunks > TILEMAP_MAX_CHUNKS) {
+    tilemapClose(map);
+    return -1;
+  }
+  return 0;
+}
+
+void tilemapClose(Tilemap *map) {
+  if (map->file)
+    SDL_RWclose(map->file);
+  map->file = NULL;
+  map->widthChunks = 0;
+}
+
+void tilemapStream(Tilemap *map, float cameraX, int viewW) {
+  int first = (int)cameraX / CHUNK_PX - 1;
+  int last = ((int)cameraX + viewW) / CHUNK_PX + 1;
+  int index;
+
+  map->clock++;
+  first = SDL_max(first, 0);
+  last = SDL_min(last, map->widthChunks - 1);
+
+  for (index = first; index <= last; index++) {
+    int slot = findChunk(map, index);
+    TileChunk *chunk;
+
+    if (slot >= 0) {
+      chunk = &map->resident[slot];
+    } else {
+      chunk = recycleChunk(map);
+      loadChunk(map, chunk, index);
+    }
+    chunk->lastUse = map->clock;
+  }
+}
+
+int tilemapTile(const Tilemap *map, int tx, int ty) {
+  int slot;
+
+  if (tx < 0 || ty < 0 || ty >= CHUNK_H)
+    return TILE_EMPTY;
+  slot = findChunk(map, tx / CHUNK_W);
+  return slot >= 0 ? map->resident[slot].tiles[ty][tx % CHUNK_W] : TILE_EMPTY;
+}
+
+const TileChunk *tilemapPeekChunk(const Tilemap *map, int index,
+                                  TileChunk *scratch) {
+  int slot = findChunk(map, index);
+
+  if (slot >= 0)
+    return &map->resident[slot];
+  if (index >= 0 && index < map->widthChunks && map->file) {
+    readChunk(map, scratch, index); /* empty when it fails */
+  } else {
+    scratch->index = index;
+    memset(scratch->tiles, TILE_EMPTY, sizeof(scratch->tiles));
+    buildSolidMasks(scratch);
+  }
+  return scratch;
+}
+
+int tilemapWidthPx(const Tilemap *map) { return map->widthChunks * CHUNK_PX; }
+
+/*
+ * Axis-separated sweep. Along each axis only the tiles the leading edge
+ * enters are tested: columns with one masked bit scan per chunk, rows with
+ * one mask test per row.
+ */
+int tilemapMove(const Tilemap *map, TileBox *box, Real dx, Real dy) {
+  int hits = 0;
+  int ty0 = tileOf(box->y);
+  int ty1 = tileOf(box->y + box->h - EDGE);
+  int tx0, tx1, from, to, hit;
+
+  if (dx > 0) {
+    from = tileOf(box->x + box->w - EDGE) + 1;
+    to = tileOf(box->x + box->w + dx - EDGE);
+    hit = to >= from ? firstSolidColumn(map, from, to, ty0, ty1) : -1;
+    if (hit >= 0) {
+      box->x = realFromInt(hit * TILE_SIZE) - box->w;
+      hits |= TILE_HIT_WALL;
+    } else {
+      box->x += dx;
+    }
+  } else if (dx < 0) {
+    from = tileOf(box->x + dx);
+    to = tileOf(box->x) - 1;
+    hit = to >= from ? lastSolidColumn(map, from, to, ty0, ty1) : -1;
+    if (hit >= 0) {
+      box->x = realFromInt((hit + 1) * TILE_SIZE);
+      hits |= TILE_HIT_WALL;
+    } else {
+      box->x += dx;
+    }
+  }
+
+  tx0 = tileOf(box->x);
+  tx1 = tileOf(box->x + box->w - EDGE);
+
+  if (dy > 0) {
+    from = tileOf(box->y + box->h - EDGE) + 1;
+    to = tileOf(box->y + box->h + dy - EDGE);
+    for (; from <= to; from++)
+      if (rowSolid(map, from, tx0, tx1))
+        break;
+    if (from <= to) {
+      box->y = realFromInt(from * TILE_SIZE) - box->h;
+      hits |= TILE_HIT_FLOOR;
+    } else {
+      box->y += dy;
+    }
+  } else if (dy < 0) {
+    from = tileOf(box->y) - 1;
+    to = tileOf(box->y + dy);
+    for (; from >= to; from--)
+      if (rowSolid(map, from, tx0, tx1))
+        break;
+    if (from >= to) {
+      box->y = realFromInt((from + 1) * TILE_SIZE);
+      hits |= TILE_HIT_CEILING;
+    } else {
+      box->y += dy;
+    }
+  }
+
+  return hits;
+}
+
+/* one batched fill per tile type, the draw lists live in the frame arena */
+void tilemapDraw(const Tilemap *map, SDL_Renderer *renderer, float cameraX,
+                 int viewW, int viewH) {
+  int firstCol = (int)cameraX / TILE_SIZE;
+  int cols = viewW / TILE_SIZE + 2;
+  int rows = SDL_min(viewH / TILE_SIZE + 1, CHUNK_H);
+  int counts[TILE_TYPES];
+  SDL_Rect *rects[TILE_TYPES];
+  int col, row, type;
+
+  for (type = 1; type < TILE_TYPES; type++) {
+    rects[type] =
+        (SDL_Rect *)frameAlloc(sizeof(SDL_Rect) * (size_t)(cols * rows));
+    if (!rects[type])
+      return;
+    counts[type] = 0;
+  }
+
+  for (col = 0; col < cols; col++) {
+    int tx = firstCol + col;
+    int slot = findChunk(map, tx / CHUNK_W);
+    if (slot < 0)
+      continue;
+
+    for (row = 0; row < rows; row++) {
+      SDL_Rect *rect;
+      type = map->resident[slot].tiles[row][tx % CHUNK_W];
+      if (type == TILE_EMPTY)
+        continue;
+      rect = &rects[type][counts[type]++];
+      rect->x = tx * TILE_SIZE - (int)cameraX;
+      rect->y = row * TILE_SIZE;
+      rect->w = TILE_SIZE;
+      rect->h = TILE_SIZE;
+    }
+  }
+
+  for (type = 1; type < TILE_TYPES; type++) {
+    SDL_SetRenderDrawColor(renderer, tileColors[type][0], tileColors[type][1],
+                           tileColors[type][2], 255);
+    SDL_RenderFillRects(renderer, rects[type], counts[type]);
+  }
+}
+
+/*
+ * Rolling ground with stone platforms above it. The width is rounded up to
+ * whole chunks. Chunks are packed one at a time and their offsets patched
+ * into the table as we go, so any level length is written in constant
+ * memory.
+ */
+int tilemapGenerate(const char *path, int widthTiles, Uint32 seed) {
+  SDL_RWops *rw;
+  TileChunk chunk;
+  Uint8 packed[PACKED_MAX];
+  int chunks = (widthTiles + CHUNK_W - 1) / CHUNK_W;
+  Uint32 offset = HEADER_SIZE + (Uint32)(chunks + 1) * 4;
+  int ground = GROUND_ROW;
+  int platformLeft = 0;
+  int platformRow = 0;
+  int ok = 1;
+  int c, col, row;
+
+  if (chunks <= 0)
+    return -1;
+  rw = SDL_RWFromFile(path, "wb");
+  if (!rw)
+    return -1;
+
+  ok &= SDL_RWwrite(rw, "CLVL", 4, 1) == 1;
+  ok &= SDL_WriteLE32(rw, TILEMAP_VERSION) == 1;
+  ok &= SDL_WriteLE32(rw, (Uint32)chunks) == 1;
+  ok &= SDL_WriteLE32(rw, offset) == 1;
+  for (c = 0; c < chunks; c++) /* patched below */
+    ok &= SDL_WriteLE32(rw, 0) == 1;
+
+  for (c = 0; c < chunks && ok; c++) {
+    size_t size;
+
+    for (col = 0; col < CHUNK_W; col++) {
+      int x = c * CHUNK_W + col;
+
+      if (x >= FLAT_START && nextRandom(&seed) % 8 == 0) {
+        ground += nextRandom(&seed) % 2 ? 1 : -1;
+        ground = SDL_max(SDL_min(ground, GROUND_MAX), GROUND_MIN);
+      }
+      if (x >= FLAT_START && !platformLeft && nextRandom(&seed) % 24 == 0) {
+        platformLeft = 3 + (int)(nextRandom(&seed) % 4);
+        platformRow = ground - 4;
+      }
+
+      for (row = 0; row < CHUNK_H; row++)
+        chunk.tiles[row][col] = (Uint8)(row < ground    ? TILE_EMPTY
+                                        : row == ground ? TILE_GRASS
+                                                        : TILE_DIRT);
+      if (platformLeft) {
+        if (platformRow < ground - 2)
+          chunk.tiles[platformRow][col] = TILE_STONE;
+        platformLeft--;
+      }
+    }
+
+    size = packChunk(&chunk, packed);
+    offset += (Uint32)size;
+    ok &= SDL_RWseek(rw, 0, RW_SEEK_END) >= 0;
+    ok &= SDL_RWwrite(rw, packed, size, 1) == 1;
+    ok &= SDL_RWseek(rw, HEADER_SIZE + (Sint64)(c + 1) * 4, RW_SEEK_SET) >= 0;
+    ok &= SDL_WriteLE32(rw, offset) == 1;
+  }
+
+  if (SDL_RWclose(rw) != 0)
+    ok = 0;
+  return ok ? 0 : -1;
+}
@@ -0,0 +1,96 @@
+#ifndef TILEMAP_H
+#define TILEMAP_H
+
+#include "fixed.h"
+#include <SDL2/SDL.h>
+
+/*
+ * Side-scrolling tile world. The level is stored on disk as fixed-size
+ * chunks of CHUNK_W x CHUNK_H tiles, each run-length encoded, behind a
+ * table of chunk offsets:
+ *
+ *   "CLVL" | version | width in chunks | (chunks + 1) * offset | chunks
+ *
+ * Only TILEMAP_RESIDENT chunks are ever in memory. tilemapStream() keeps
+ * the ones around the camera loaded and recycles the rest, reading the
+ * offset table on demand, so memory use does not depend on level length.
+ *
+ * Collision never looks at tiles one by one: each chunk row keeps a bitmask
+ * of its solid columns, and boxes are swept against those masks with bit
+ * scans, a handful of word operations per move.
+ */
+
+#define TILE_SIZE 16
+#define CHUNK_W 32
+#define CHUNK_H 16
+#define CHUNK_PX (CHUNK_W * TILE_SIZE)
+#define TILEMAP_RESIDENT 8
+
+/* widest level tilemapOpen() takes; 16.16 fixed point reaches 32767 pixels */
+#ifdef FIXED_POINT
+#define TILEMAP_MAX_CHUNKS (32767 / CHUNK_PX)
+#else
+#define TILEMAP_MAX_CHUNKS (SDL_MAX_SINT32 / CHUNK_PX)
+#endif
+
+#define TILE_EMPTY 0
+#define TILE_DIRT 1
+#define TILE_GRASS 2
+#define TILE_STONE 3
+#define TILE_TYPES 4
+
+/* tilemapMove() results */
+#define TILE_HIT_WALL 1
+#define TILE_HIT_FLOOR 2
+#define TILE_HIT_CEILING 4
+
+typedef struct {
+  int index; /* chunk number in the level, -1 when the slot is free */
+  Uint32 lastUse;
+  Uint8 tiles[CHUNK_H][CHUNK_W];
+  Uint32 solid[CHUNK_H]; /* bit n set when column n of the row is solid */
+} TileChunk;
+
+typedef struct {
+  Real x, y, w, h;
+} TileBox;
+
+typedef struct {
+  SDL_RWops *file;
+  int widthChunks;
+  TileChunk resident[TILEMAP_RESIDENT];
+  Uint32 clock;
+  unsigned long loads, evictions;
+} Tilemap;
+
+int tilemapOpen(Tilemap *map, const char *path);
+void tilemapClose(Tilemap *map);
+
+/* loads what the view needs and a chunk of margin on both sides */
+void tilemapStream(Tilemap *map, float cameraX, int viewW);
+
+/* TILE_EMPTY outside the level or where nothing is resident */
+int tilemapTile(const Tilemap *map, int tx, int ty);
+int tilemapWidthPx(const Tilemap *map);
+
+/*
+ * The chunk's tiles whether or not it is resident: the resident copy, or
+ * else read into scratch without loading it, empty outside the level. For
+ * what must not depend on where the camera has been.
+ */
+const TileChunk *tilemapPeekChunk(const Tilemap *map, int index,
+                                  TileChunk *scratch);
+
+/*
+ * Moves the box by dx, then by dy, stopping it flush against solid tiles.
+ * Returns the TILE_HIT_ flags of what it ran into.
+ */
+int tilemapMove(const Tilemap *map, TileBox *box, Real dx, Real dy);
+
+void tilemapDraw(const Tilemap *map, SDL_Renderer *renderer, float cameraX,
+                 int viewW, int viewH);
+
+/* writes a procedural level, used by assetcook and the benchmark */
+int tilemapGenerate(const char *path, int widthTiles, Uint32 seed);
+
+#endif